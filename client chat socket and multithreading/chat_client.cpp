@@ -0,0 +1,461 @@
+#include "chat_client.h"
+
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define SEND_FLAGS 0
+static int LastError() { return WSAGetLastError(); }
+static bool WouldBlock(int e) { return e == WSAEWOULDBLOCK; }
+static bool InProgress(int e) { return e == WSAEWOULDBLOCK || e == WSAEINPROGRESS; }
+static void SetNonBlocking(SOCKET s) { u_long on = 1; ioctlsocket(s, FIONBIO, &on); }
+#else
+// Lets bots and load tests run the same code on Linux
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#define SEND_FLAGS MSG_NOSIGNAL
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#define WSAPoll poll
+typedef pollfd WSAPOLLFD;
+static int LastError() { return errno; }
+static bool WouldBlock(int e) { return e == EAGAIN || e == EWOULDBLOCK; }
+static bool InProgress(int e) { return e == EINPROGRESS || WouldBlock(e); }
+static void SetNonBlocking(SOCKET s) { fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK); }
+#endif
+
+#define CONNECT_TIMEOUT_MS 10000
+#define RECV_CHUNK 512
+
+// WSAPoll does not report failed connects on older Windows, so
+// connects in progress also time out and keep the poll timeout short.
+// Sessions waiting for COMPRESS_OFFER use the same short timeout.
+#define CONNECT_POLL_MS 250
+
+// A server without compression never offers it; after this long the
+// held sends go out plain. Servers send the offer on accept, ahead of
+// everything else, so it only misses this on a badly stalled link.
+#define OFFER_TIMEOUT_MS 2000
+
+static unsigned long long NowMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ==================== ChatSession ====================
+ChatSession::ChatSession(ChatLoop& l) : loop(l) {
+    loop.Add(this);
+}
+
+ChatSession::~ChatSession() {
+    Close();
+    loop.Remove(this);
+}
+
+ChatSession::ConnectAwait ChatSession::Connect(const char* ip, int port) {
+    // Reconnecting a live session drops the old connection first
+    if (sock != INVALID_SOCKET) Close();
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    closed = false;
+    connectDone = false;
+    firstBytes = true;
+    offerWait = compress;
+    awaitingAck = false;
+    if (compress) {
+        encoder.reset(new ChatEncoder());
+        decoder.reset(new ChatDecoder());
+    }
+
+    if (sock == INVALID_SOCKET) {
+        FinishConnect(false);
+        return ConnectAwait{ this };
+    }
+
+    SetNonBlocking(sock);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+
+    if (connect(sock, (sockaddr*)&addr, sizeof(addr)) != SOCKET_ERROR) {
+        FinishConnect(true);
+    } else if (InProgress(LastError())) {
+        connecting = true;
+        connectDeadline = NowMs() + CONNECT_TIMEOUT_MS;
+    } else {
+        FinishConnect(false);
+    }
+    return ConnectAwait{ this };
+}
+
+void ChatSession::FinishConnect(bool ok) {
+    connecting = false;
+    connectDone = true;
+    connected = ok;
+    if (!ok) {
+        Close();
+        return;
+    }
+    if (offerWait) offerDeadline = NowMs() + OFFER_TIMEOUT_MS;
+    FlushWrites();
+}
+
+// The server offered compression, or it didn't (or not in time). The
+// HELLO goes out only after an offer, so the server can't upgrade a
+// connection this end has already settled as plain. Held sends follow
+// it, compressed or not.
+void ChatSession::EndOffer(bool offered) {
+    offerWait = false;
+    if (offered) {
+        writeBuf.append(COMPRESS_HELLO, COMPRESS_HELLO_LEN);
+        awaitingAck = true;
+    } else {
+        compress = false;
+    }
+
+    std::vector<std::string> pending;
+    pending.swap(held);
+    for (const std::string& m : pending) Send(m);
+    if (connected && !closed) FlushWrites();
+}
+
+// Strip the server's offer from the front of the stream. False while
+// the first bytes are still too few to tell. An offer for another
+// dictionary is declined: our frames would decode as garbage there.
+bool ChatSession::CheckOffer() {
+    if (!firstBytes) return true;
+    if (inbuf.empty()) return false;
+
+    size_t have = inbuf.size() < COMPRESS_OFFER_PREFIX_LEN ? inbuf.size() : COMPRESS_OFFER_PREFIX_LEN;
+    bool offer = inbuf.compare(0, have, COMPRESS_OFFER, have) == 0;
+    if (offer && inbuf.size() < COMPRESS_OFFER_LEN) return false;
+
+    firstBytes = false;
+    bool usable = offer && inbuf.compare(0, COMPRESS_OFFER_LEN, CompressOffer()) == 0;
+    if (offer) inbuf.erase(0, COMPRESS_OFFER_LEN);
+    if (offerWait) EndOffer(usable);    // else plain already, late offer or not
+    return true;
+}
+
+void ChatSession::Send(const char* msg, size_t len) {
+    if (closed) return;
+    if (offerWait) {
+        held.emplace_back(msg, len);
+        return;
+    }
+
+    if (compress) AppendFrame(writeBuf, FRAME_MSG, encoder->Compress(msg, len));
+    else writeBuf.append(msg, len);
+    if (connected) FlushWrites();
+}
+
+// Put as much of writeBuf on the wire as the socket takes right now.
+void ChatSession::FlushWrites() {
+    size_t sent = 0;
+    while (sent < writeBuf.size()) {
+        int n = send(sock, writeBuf.data() + sent, (int)(writeBuf.size() - sent), SEND_FLAGS);
+        if (n > 0) {
+            sent += n;
+        } else {
+            if (!WouldBlock(LastError())) Close();
+            break;
+        }
+    }
+    if (!closed) writeBuf.erase(0, sent);
+}
+
+// True when Recv() has a result: data, or "" for a closed connection
+// (or one that was never opened: nothing would ever wake the wait).
+bool ChatSession::TryRecv() {
+    if (closed || sock == INVALID_SOCKET || (connectDone && !connected)) {
+        received.clear();
+        return true;
+    }
+    if (!connected) return false;
+
+    while (true) {
+        if (NextMessage()) return true;
+
+        char buffer[RECV_CHUNK];
+        int n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            inbuf.append(buffer, n);
+            continue;
+        }
+        if (n < 0 && WouldBlock(LastError())) return false;
+
+        Close();
+        received.clear();
+        return true;
+    }
+}
+
+// Take one message out of inbuf, if a whole one is there.
+bool ChatSession::NextMessage() {
+    if (!CheckOffer()) return false;
+
+    if (awaitingAck) {
+        // Broadcasts sent before the server saw the HELLO come plain,
+        // and plain text never holds a NUL: everything up to one is
+        // an ordinary message.
+        size_t nul = inbuf.find('\0');
+        if (nul != 0) {
+            if (inbuf.empty()) return false;
+            received.assign(inbuf, 0, nul);
+            inbuf.erase(0, nul);
+            return true;
+        }
+
+        size_t have = inbuf.size() < COMPRESS_ACK_LEN ? inbuf.size() : COMPRESS_ACK_LEN;
+        if (inbuf.compare(0, have, COMPRESS_ACK, have) == 0) {
+            if (have < COMPRESS_ACK_LEN) return false;
+            inbuf.erase(0, COMPRESS_ACK_LEN);
+            awaitingAck = false;
+        } else {
+            // It offered, so anything else is a broken stream
+            Close();
+            received.clear();
+            return true;
+        }
+    }
+
+    if (!compress) {
+        if (inbuf.empty()) return false;
+        received.swap(inbuf);
+        inbuf.clear();
+        return true;
+    }
+
+    while (true) {
+        size_t pos = 0;
+        int flag;
+        std::string payload;
+        int r = ParseFrame(inbuf, pos, flag, payload);
+        if (r == 0) return false;
+        if (r < 0) break;
+        inbuf.erase(0, pos);
+
+        received.clear();
+        if (flag == FRAME_SYNC) {
+            if (payload.empty()) decoder->Reset();
+            else decoder->Prime(payload);
+        } else if (flag == FRAME_PLAIN) {
+            received.swap(payload);
+        } else if (!decoder->Decompress(payload, received)) {
+            break;
+        }
+
+        // Echoes only keep the decoder in step with the server
+        if (flag != FRAME_ECHO && !received.empty()) return true;
+    }
+
+    // Corrupt stream: nothing after this can be decoded
+    Close();
+    received.clear();
+    return true;
+}
+
+void ChatSession::Close() {
+    if (sock != INVALID_SOCKET) closesocket(sock);
+    sock = INVALID_SOCKET;
+    closed = true;
+    connected = false;
+    connecting = false;
+    offerWait = false;
+    awaitingAck = false;
+    writeBuf.clear();
+    inbuf.clear();
+    held.clear();
+}
+
+// Called by the loop. Resumes at most one waiter and returns right
+// after, since the coroutine may destroy this session.
+void ChatSession::OnEvents(short revents) {
+    if (offerWait && connected) {
+        // Read the offer even if nobody is in Recv(): sends are held on it
+        if (revents & (POLLRDNORM | POLLERR | POLLHUP)) {
+            char buffer[RECV_CHUNK];
+            int n = recv(sock, buffer, sizeof(buffer), 0);
+            if (n > 0) inbuf.append(buffer, n);
+            else if (n == 0 || !WouldBlock(LastError())) Close();
+            if (!closed) CheckOffer();
+        }
+        if (offerWait && NowMs() >= offerDeadline) EndOffer(false);
+    }
+
+    if (connecting) {
+        bool expired = NowMs() >= connectDeadline;
+        if (!(revents & (POLLWRNORM | POLLERR | POLLHUP)) && !expired) return;
+
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+        FinishConnect(err == 0 && !expired && !(revents & (POLLERR | POLLHUP)));
+    } else if (connected && (revents & POLLWRNORM) && !writeBuf.empty()) {
+        FlushWrites();
+    }
+
+    if (connectDone && connectWaiter) {
+        std::coroutine_handle<> h = connectWaiter;
+        connectWaiter = nullptr;
+        h.resume();
+        return;
+    }
+
+    if (readWaiter && TryRecv()) {
+        std::coroutine_handle<> h = readWaiter;
+        readWaiter = nullptr;
+        h.resume();
+    }
+}
+
+// ==================== ChatLoop ====================
+ChatLoop::ChatLoop() : stopping(false) {
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2,2), &wsa);
+#endif
+
+    // Post() from other threads wakes WSAPoll with a datagram to ourselves
+    wakeSock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(wakeSock, (sockaddr*)&addr, sizeof(addr));
+
+    socklen_t len = sizeof(addr);
+    getsockname(wakeSock, (sockaddr*)&addr, &len);
+    connect(wakeSock, (sockaddr*)&addr, sizeof(addr));
+    SetNonBlocking(wakeSock);
+}
+
+ChatLoop::~ChatLoop() {
+    closesocket(wakeSock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void ChatLoop::Add(ChatSession* s) {
+    sessions.push_back(s);
+    liveSessions++;
+}
+
+void ChatLoop::Remove(ChatSession* s) {
+    for (ChatSession*& p : sessions)
+        if (p == s) { p = nullptr; liveSessions--; break; }
+}
+
+void ChatLoop::Post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(postMtx);
+        posted.push_back(std::move(fn));
+    }
+    Wake();
+}
+
+void ChatLoop::Wake() {
+    send(wakeSock, "w", 1, SEND_FLAGS);
+}
+
+void ChatLoop::Stop() {
+    stopping = true;
+    Wake();
+}
+
+void ChatLoop::Run() {
+    while (!stopping) RunOnce(-1);
+}
+
+void ChatLoop::RunPosted() {
+    std::vector<std::function<void()>> work;
+    {
+        std::lock_guard<std::mutex> lock(postMtx);
+        work.swap(posted);
+    }
+    for (auto& fn : work) fn();
+}
+
+void ChatLoop::RunOnce(int timeoutMs) {
+    RunPosted();
+
+    // Drop sessions destroyed since the last round
+    size_t n = 0;
+    for (ChatSession* s : sessions)
+        if (s) sessions[n++] = s;
+    sessions.resize(n);
+
+    std::vector<WSAPOLLFD> fds;
+    std::vector<size_t> owner;      // fds[i + 1] belongs to sessions[owner[i]]
+    std::vector<size_t> settled;    // closed sessions with someone still waiting
+    std::vector<size_t> handshaking;    // waiting for COMPRESS_OFFER, see OFFER_TIMEOUT_MS
+
+    WSAPOLLFD wake{};
+    wake.fd = wakeSock;
+    wake.events = POLLRDNORM;
+    fds.push_back(wake);
+
+    for (size_t i = 0; i < sessions.size(); i++) {
+        ChatSession* s = sessions[i];
+        if (s->sock == INVALID_SOCKET) {
+            if (s->connectWaiter || s->readWaiter) settled.push_back(i);
+            continue;
+        }
+        if (s->offerWait && s->connected) {
+            handshaking.push_back(i);
+            if (timeoutMs < 0 || timeoutMs > CONNECT_POLL_MS) timeoutMs = CONNECT_POLL_MS;
+        }
+
+        WSAPOLLFD f{};
+        f.fd = s->sock;
+        if (s->connecting) f.events = POLLWRNORM;
+        else {
+            if (s->readWaiter || s->offerWait) f.events |= POLLRDNORM;
+            if (!s->writeBuf.empty()) f.events |= POLLWRNORM;
+        }
+        if (s->connecting) {
+            if (timeoutMs < 0 || timeoutMs > CONNECT_POLL_MS) timeoutMs = CONNECT_POLL_MS;
+        } else if (!f.events) {
+            continue;
+        }
+        fds.push_back(f);
+        owner.push_back(i);
+    }
+    if (!settled.empty()) timeoutMs = 0;
+
+    WSAPoll(fds.data(), (unsigned long)fds.size(), timeoutMs);
+
+    if (fds[0].revents) {
+        char drain[64];
+        while (recv(wakeSock, drain, sizeof(drain), 0) > 0) {}
+    }
+
+    // Resumed coroutines may create or destroy sessions; entries are
+    // only nulled or appended meanwhile, so indices stay valid.
+    for (size_t i = 0; i < owner.size(); i++) {
+        ChatSession* s = sessions[owner[i]];
+        if (s && (fds[i + 1].revents || s->connecting)) s->OnEvents(fds[i + 1].revents);
+    }
+    for (size_t i : settled) {
+        ChatSession* s = sessions[i];
+        if (s) s->OnEvents(0);
+    }
+    for (size_t i : handshaking) {
+        ChatSession* s = sessions[i];
+        if (s && s->offerWait && NowMs() >= s->offerDeadline) s->OnEvents(0);
+    }
+
+    RunPosted();
+}
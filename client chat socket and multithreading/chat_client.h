@@ -0,0 +1,162 @@
+#ifndef CHAT_CLIENT_H
+#define CHAT_CLIENT_H
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../common/chat_compress.h"
+
+/*
+========================================================
+CHAT CLIENT LIBRARY (no GUI)
+--------------------------------------------------------
+- ChatLoop: single-threaded reactor over non-blocking
+  sockets (WSAPoll). One loop can drive thousands of
+  ChatSessions; Post() hands work to it from any thread
+- ChatSession: one server connection
+      bool ok         = co_await session.Connect(ip, port);
+      std::string msg = co_await session.Recv();  // "" = closed
+      session.Send(text);                         // never blocks
+  Send() writes straight away if it can and queues the
+  rest, so several sends can be in flight at once
+- EnableCompression() before Connect asks the server for
+  compressed frames if it offers them (see
+  chat_compress.h). Sends wait for the server's first
+  bytes, and go out plain if no offer comes within
+  OFFER_TIMEOUT_MS (a server without compression)
+- ChatTask: fire-and-forget coroutine type for session
+  code; calling one runs it up to its first co_await
+- Sessions, awaits and Send() belong to the loop thread
+- Needs -std=c++20
+========================================================
+*/
+
+class ChatLoop;
+
+// -------------------- Coroutine task --------------------
+struct ChatTask {
+    struct promise_type {
+        ChatTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// -------------------- Session --------------------
+class ChatSession {
+public:
+    explicit ChatSession(ChatLoop& loop);
+    ~ChatSession();
+
+    ChatSession(const ChatSession&) = delete;
+    ChatSession& operator=(const ChatSession&) = delete;
+
+    struct ConnectAwait {
+        ChatSession* s;
+        bool await_ready() const { return s->connectDone; }
+        void await_suspend(std::coroutine_handle<> h) { s->connectWaiter = h; }
+        bool await_resume() const { return s->connected; }
+    };
+
+    struct RecvAwait {
+        ChatSession* s;
+        bool await_ready() { return s->TryRecv(); }
+        void await_suspend(std::coroutine_handle<> h) { s->readWaiter = h; }
+        std::string await_resume() { std::string m; m.swap(s->received); return m; }
+    };
+
+    ConnectAwait Connect(const char* ip, int port);
+    RecvAwait Recv() { return RecvAwait{ this }; }
+    void Send(const char* msg, size_t len);
+    void Send(const std::string& msg) { Send(msg.data(), msg.size()); }
+    void Close();
+
+    void EnableCompression(bool on) { compress = on; }
+    bool Compressed() const { return compress && !offerWait && !awaitingAck; }
+    bool Connected() const { return connected; }
+    size_t Queued() const { return writeBuf.size(); }
+
+private:
+    friend class ChatLoop;
+
+    bool TryRecv();
+    bool NextMessage();
+    void FlushWrites();
+    void FinishConnect(bool ok);
+    bool CheckOffer();
+    void EndOffer(bool offered);
+    void OnEvents(short revents);
+
+    ChatLoop& loop;
+    SOCKET sock = INVALID_SOCKET;
+    bool connecting = false, connectDone = false, connected = false, closed = false;
+    unsigned long long connectDeadline = 0;     // ms, see CONNECT_TIMEOUT_MS
+
+    std::string received;       // result handed to the next Recv()
+    std::string inbuf;          // bytes read but not yet handed out
+    std::string writeBuf;       // bytes accepted by Send() but not yet on the wire
+
+    bool compress = false;
+    bool firstBytes = false;    // the server's opening bytes (maybe COMPRESS_OFFER) not read yet
+    bool offerWait = false;     // compress wanted, server's answer pending
+    bool awaitingAck = false;   // HELLO sent; plain broadcasts may come before the ACK
+    unsigned long long offerDeadline = 0;       // ms, see OFFER_TIMEOUT_MS
+    std::vector<std::string> held;      // sends waiting for the offer
+    std::unique_ptr<ChatEncoder> encoder;   // only allocated when compressing
+    std::unique_ptr<ChatDecoder> decoder;
+
+    std::coroutine_handle<> connectWaiter, readWaiter;
+};
+
+// -------------------- Event loop --------------------
+class ChatLoop {
+public:
+    ChatLoop();
+    ~ChatLoop();
+
+    ChatLoop(const ChatLoop&) = delete;
+    ChatLoop& operator=(const ChatLoop&) = delete;
+
+    // Poll once and resume whatever became ready.
+    void RunOnce(int timeoutMs);
+    // Loop until Stop() is called (from any thread).
+    void Run();
+    void Stop();
+
+    // Run fn on the loop thread. Safe from any thread.
+    void Post(std::function<void()> fn);
+
+    size_t Sessions() const { return liveSessions; }
+
+private:
+    friend class ChatSession;
+
+    void Add(ChatSession* s);
+    void Remove(ChatSession* s);
+    void Wake();
+    void RunPosted();
+
+    std::vector<ChatSession*> sessions;   // removed entries are nulled, compacted in RunOnce
+    size_t liveSessions = 0;
+
+    SOCKET wakeSock = INVALID_SOCKET;     // UDP socket connected to itself
+    std::mutex postMtx;
+    std::vector<std::function<void()>> posted;
+    std::atomic<bool> stopping;
+};
+
+#endif
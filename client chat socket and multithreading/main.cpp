@@ -1,10 +1,15 @@
 #include <windows.h>
 #include <winsock2.h>
-#include <ws2tcpip.h>
 #include <string>
+#include <thread>
+#include <atomic>
 
 #pragma comment(lib, "ws2_32.lib")
 #include "resource.h"
+#include "../common/message_view_win32.h"
+#include "chat_client.h"
+
+#define WM_APP_LOG (WM_APP + 1)
 
 /*
 ========================================================
@@ -12,12 +17,16 @@ TCP CHAT CLIENT (GUI)
 --------------------------------------------------------
 Socket and multithreading chat server.
 sends messages through socket in the GUI.
+Networking lives in chat_client.h; this window is just
+one consumer of it, driving a ChatLoop on a worker thread.
 ========================================================
 */
 
-HWND hIpInput, hPortInput, hMsgInput, hConnectBtn, hSendBtn, hLogBox;
-SOCKET clientSocket = INVALID_SOCKET;
-bool connected = false;
+HWND hMainWnd, hIpInput, hPortInput, hMsgInput, hConnectBtn, hSendBtn, hCompressBox, hLogBox;
+MessageView logView;
+ChatLoop chatLoop;
+ChatSession session(chatLoop);     // only touched on the loop thread
+std::atomic<bool> connected(false), sessionActive(false);
 
 // -------------------- Colors --------------------
 COLORREF winBgColor   = RGB(225, 240, 255);   // window background
@@ -27,27 +36,38 @@ COLORREF btnTextColor = RGB(255, 255, 255);   // button text
 COLORREF logBgColor   = RGB(245, 255, 255);   // log box
 
 // -------------------- Logging --------------------
+// Any thread may call Log(); lines are queued in logView and the
+// window flushes them to the EDIT control in one batch (WM_APP_LOG).
 void Log(const char* text) {
-    int len = GetWindowTextLength(hLogBox);
-    SendMessage(hLogBox, EM_SETSEL, len, len);
-    SendMessage(hLogBox, EM_REPLACESEL, 0, (LPARAM)text);
-    SendMessage(hLogBox, EM_REPLACESEL, 0, (LPARAM)"\r\n");
+    if (logView.Push(text) && hMainWnd)
+        PostMessage(hMainWnd, WM_APP_LOG, 0, 0);
 }
 
-// -------------------- Receiver Thread --------------------
-DWORD WINAPI ReceiverThread(LPVOID) {
-    char buffer[512];
-    while (connected) {
-        int bytes = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        if (bytes <= 0) {
-            Log("Disconnected from server.");
-            connected = false;
-            break;
-        }
-        buffer[bytes] = 0;
-        Log(buffer);
+// -------------------- Session --------------------
+// Runs on the loop thread from Connect until the server goes away.
+// Compression is opt-in (the "Compress" box): it only pays off on a
+// busy server, and both ends need the same dictionary.
+ChatTask RunSession(std::string ip, int port, bool compress) {
+    Log("Connecting...");
+    session.EnableCompression(compress);
+    if (!co_await session.Connect(ip.c_str(), port)) {
+        Log("Connection failed.");
+        sessionActive = false;
+        co_return;
     }
-    return 0;
+
+    connected = true;
+    Log("Connected.");
+
+    while (true) {
+        std::string msg = co_await session.Recv();
+        if (msg.empty()) break;
+        Log(msg.c_str());
+    }
+
+    connected = false;
+    sessionActive = false;
+    Log("Disconnected from server.");
 }
 
 // -------------------- Owner-drawn button --------------------
@@ -66,6 +86,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
 
     case WM_CREATE:
+        hMainWnd = hwnd;
+
         // Static labels
         CreateWindow("STATIC", "Server IP", WS_CHILD | WS_VISIBLE, 50, 20, 100, 20, hwnd, NULL, NULL, NULL);
         CreateWindow("STATIC", "Port", WS_CHILD | WS_VISIBLE, 200, 20, 100, 20, hwnd, NULL, NULL, NULL);
@@ -78,6 +100,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         hConnectBtn = CreateWindow("BUTTON", "Connect", WS_CHILD | WS_VISIBLE | BS_OWNERDRAW,
             300, 45, 100, 25, hwnd, (HMENU)1, NULL, NULL);
 
+        // Compression checkbox, off by default
+        hCompressBox = CreateWindow("BUTTON", "Compress", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+            410, 45, 80, 25, hwnd, (HMENU)3, NULL, NULL);
+
         // Message input
         hMsgInput = CreateWindow("EDIT", "", WS_CHILD | WS_VISIBLE | WS_BORDER,
             50, 90, 300, 30, hwnd, NULL, NULL, NULL);
@@ -89,35 +115,25 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         // Scrollable log box
         hLogBox = CreateWindow("EDIT", "", WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL |
             ES_MULTILINE | ES_READONLY, 50, 140, 400, 300, hwnd, NULL, NULL, NULL);
+
+        // Size is bounded by logView, not by the default 32K EDIT limit
+        SendMessage(hLogBox, EM_SETLIMITTEXT, 0, 0);
+        PostMessage(hwnd, WM_APP_LOG, 0, 0);
         break;
 
     case WM_COMMAND:
         // Connect button clicked
-        if (LOWORD(wParam) == 1 && !connected) {
+        if (LOWORD(wParam) == 1 && !sessionActive) {
             char ip[32], portStr[16];
             GetWindowText(hIpInput, ip, sizeof(ip));
             GetWindowText(hPortInput, portStr, sizeof(portStr));
 
-            WSADATA wsa;
-            WSAStartup(MAKEWORD(2,2), &wsa);
-
-            clientSocket = socket(AF_INET, SOCK_STREAM, 0);
-
-            sockaddr_in addr{};
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(atoi(portStr));
-            inet_pton(AF_INET, ip, &addr.sin_addr);
-
-            Log("Connecting...");
-
-            if (connect(clientSocket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-                Log("Connection failed.");
-                closesocket(clientSocket);
-            } else {
-                connected = true;
-                Log("Connected.");
-                CreateThread(NULL, 0, ReceiverThread, NULL, 0, NULL);
-            }
+            // Connect runs on the loop thread, so the window never blocks
+            sessionActive = true;
+            std::string host = ip;
+            int port = atoi(portStr);
+            bool compress = SendMessage(hCompressBox, BM_GETCHECK, 0, 0) == BST_CHECKED;
+            chatLoop.Post([host, port, compress] { RunSession(host, port, compress); });
         }
 
         // Send button clicked
@@ -125,13 +141,18 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             char msg[256];
             GetWindowText(hMsgInput, msg, sizeof(msg));
             if (strlen(msg)) {
-                send(clientSocket, msg, strlen(msg), 0);
+                std::string text = msg;
+                chatLoop.Post([text] { session.Send(text); });
                 Log((std::string("You: ") + msg).c_str());
                 SetWindowText(hMsgInput, "");
             }
         }
         break;
 
+    case WM_APP_LOG:
+        FlushToEdit(logView, hLogBox);
+        return 0;
+
     case WM_DRAWITEM: {
         LPDRAWITEMSTRUCT d = (LPDRAWITEMSTRUCT)lParam;
         if (d->CtlID == 1) DrawButton(d->hDC, d->rcItem, "Connect");
@@ -161,9 +182,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     }
 
     case WM_DESTROY:
-        connected = false;
-        closesocket(clientSocket);
-        WSACleanup();
+        chatLoop.Post([] { session.Close(); });
         PostQuitMessage(0);
         break;
     }
@@ -195,10 +214,19 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow) {
 
     ShowWindow(hwnd, nCmdShow);
 
+    // Must match the server's, or it stays uncompressed (see chat_compress.h)
+    if (LoadChatDictionary(CHAT_DICTIONARY_FILE))
+        Log("Loaded compression dictionary " CHAT_DICTIONARY_FILE ".");
+
+    std::thread loopThread([] { chatLoop.Run(); });
+
     MSG msg;
     while (GetMessage(&msg, NULL, 0, 0)) {
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }
+
+    chatLoop.Stop();
+    loopThread.join();
     return 0;
 }
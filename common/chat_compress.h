@@ -0,0 +1,287 @@
+#ifndef CHAT_COMPRESS_H
+#define CHAT_COMPRESS_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cstdio>
+
+/*
+========================================================
+STREAMING CHAT COMPRESSION (shared by socket client/server)
+--------------------------------------------------------
+- LZ77 with an LZ4-style token format, small enough to
+  live in one header (no external zlib/zstd needed)
+- Streaming: encoder and decoder keep the last
+  COMPRESS_WINDOW bytes of every message they've seen, so
+  a repeated name or phrase costs 3 bytes the second time
+- Both sides start primed with the same dictionary, so even
+  the first "Server: " or "Client connected." is cheap:
+  CHAT_DICTIONARY_FILE if LoadChatDictionary() found one
+  (`ipcbench -train` builds it from real logs), else the
+  built-in CHAT_DICTIONARY
+- Negotiation: a server that compresses opens every
+  connection with CompressOffer(), which names its
+  dictionary. Only a client that saw it, with the same
+  dictionary, sends COMPRESS_HELLO (as its first bytes),
+  and the server answers COMPRESS_ACK. All three start with a
+  NUL, which plain chat never carries (servers send
+  strlen() of what they got), so a client can tell them
+  from plain text. A client that gives up waiting for the
+  offer stays plain for good and drops a late one, so the
+  two ends never disagree on the protocol
+- Framing after the ACK:
+      [flag][payload length varint][payload]
+  flag FRAME_MSG   compressed message, show it
+       FRAME_ECHO  compressed message, only advance state
+                   (the server's copy of your own message)
+       FRAME_SYNC  empty: back to the dictionary (a new
+                   epoch, see the server); otherwise a raw
+                   window snapshot that replaces history
+       FRAME_PLAIN uncompressed text for this connection
+                   only (notices); leaves state alone
+========================================================
+*/
+
+#define COMPRESS_OFFER  "\0ZCHAT2?"     // + 8 hex digits of ChatDictionaryId() + "\n"
+#define COMPRESS_HELLO  "\0ZCHAT2\n"
+#define COMPRESS_ACK    "\0ZCHAT2+\n"
+#define COMPRESS_OFFER_PREFIX_LEN (sizeof(COMPRESS_OFFER) - 1)     // strlen() stops at the NUL
+#define COMPRESS_OFFER_LEN (COMPRESS_OFFER_PREFIX_LEN + 9)
+#define COMPRESS_HELLO_LEN (sizeof(COMPRESS_HELLO) - 1)
+#define COMPRESS_ACK_LEN   (sizeof(COMPRESS_ACK) - 1)
+#define COMPRESS_WINDOW 32768
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_HASH_BITS 14
+
+#define FRAME_MSG  0
+#define FRAME_ECHO 1
+#define FRAME_SYNC 2
+#define FRAME_PLAIN 3
+
+#define MAX_FRAME_PAYLOAD (1 << 20)
+
+// Common chat text, used when there is no CHAT_DICTIONARY_FILE.
+#define CHAT_DICTIONARY_FILE "chat.dict"
+#define MAX_DICTIONARY_BYTES 8192       // a quarter of the window, the rest is live chat
+#define CHAT_DICTIONARY \
+    "Client connected.Client disconnected.Server started.Server: You: " \
+    "Disconnected from server.Connected.Connecting...Connection failed." \
+    "hello hi hey thanks thank you ok okay yes no please sorry what why how when where " \
+    "who is are was the and for that this with have you know just like good great " \
+    "lol haha see you later bye good morning good night how are you I'm fine " \
+    "can you do it now today tomorrow meeting lunch message send sent received "
+
+// -------------------- Dictionary --------------------
+inline std::string& ChatDictionaryStore() {
+    static std::string dict = CHAT_DICTIONARY;
+    return dict;
+}
+
+inline const std::string& ChatDictionary() { return ChatDictionaryStore(); }
+
+// Replace the built-in dictionary with a trained one. Call before any
+// encoder or decoder is made; false (built-in kept) if there's no such
+// file or it's empty. Only the first MAX_DICTIONARY_BYTES are used.
+inline bool LoadChatDictionary(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    char buf[MAX_DICTIONARY_BYTES];
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (!n) return false;
+    ChatDictionaryStore().assign(buf, n);
+    return true;
+}
+
+// FNV-1a of the dictionary, as 8 hex digits. Both ends must match.
+inline std::string ChatDictionaryId() {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : ChatDictionary()) h = (h ^ c) * 16777619u;
+    char id[9];
+    snprintf(id, sizeof(id), "%08x", h);
+    return id;
+}
+
+inline std::string CompressOffer() {
+    return std::string(COMPRESS_OFFER, COMPRESS_OFFER_PREFIX_LEN) + ChatDictionaryId() + "\n";
+}
+
+// -------------------- Frames --------------------
+inline void AppendFrame(std::string& out, int flag, const std::string& payload) {
+    out += (char)flag;
+    size_t len = payload.size();
+    while (len >= 0x80) {
+        out += (char)((len & 0x7f) | 0x80);
+        len >>= 7;
+    }
+    out += (char)len;
+    out += payload;
+}
+
+// 1 = frame parsed and pos advanced, 0 = need more bytes, -1 = corrupt
+inline int ParseFrame(const std::string& in, size_t& pos, int& flag, std::string& payload) {
+    size_t p = pos;
+    if (p >= in.size()) return 0;
+    flag = (unsigned char)in[p++];
+    if (flag > FRAME_PLAIN) return -1;
+
+    size_t len = 0;
+    int shift = 0;
+    while (true) {
+        if (p >= in.size()) return 0;
+        unsigned char b = (unsigned char)in[p++];
+        len |= (size_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+        if (shift > 28) return -1;
+    }
+    if (len > MAX_FRAME_PAYLOAD) return -1;
+    if (in.size() - p < len) return 0;
+
+    payload.assign(in, p, len);
+    pos = p + len;
+    return 1;
+}
+
+// -------------------- Encoder --------------------
+class ChatEncoder {
+public:
+    ChatEncoder() : table(1 << COMPRESS_HASH_BITS, -1), base(0) { Reset(); }
+
+    // Back to the dictionary, as a decoder does on an empty FRAME_SYNC.
+    void Reset() { Prime(ChatDictionary()); }
+
+    // Replace history (dictionary or a sync snapshot).
+    void Prime(const std::string& snapshot) {
+        hist = snapshot;
+        base = 0;
+        std::fill(table.begin(), table.end(), -1);
+        for (size_t i = 0; i + COMPRESS_MIN_MATCH <= hist.size(); i++)
+            table[Hash(i)] = (long long)i;
+    }
+
+    std::string Compress(const char* msg, size_t len) {
+        std::string out;
+        size_t start = hist.size();
+        hist.append(msg, len);
+
+        size_t end = hist.size(), i = start, lit = start;
+        while (i + COMPRESS_MIN_MATCH <= end) {
+            uint32_t h = Hash(i);
+            long long cand = table[h] - base;
+            table[h] = base + (long long)i;
+
+            if (cand >= 0 && i - (size_t)cand <= COMPRESS_WINDOW &&
+                memcmp(&hist[cand], &hist[i], COMPRESS_MIN_MATCH) == 0) {
+                size_t m = COMPRESS_MIN_MATCH;
+                while (i + m < end && hist[cand + m] == hist[i + m]) m++;
+
+                Emit(out, lit, i - lit, i - (size_t)cand, m);
+                for (size_t k = i + 1; k < i + m && k + COMPRESS_MIN_MATCH <= end; k++)
+                    table[Hash(k)] = base + (long long)k;
+                i += m;
+                lit = i;
+            } else {
+                i++;
+            }
+        }
+        Emit(out, lit, end - lit, 0, 0);
+
+        // Keep at least one full window; trim in big steps
+        if (hist.size() > 2 * COMPRESS_WINDOW) {
+            size_t drop = hist.size() - COMPRESS_WINDOW;
+            hist.erase(0, drop);
+            base += (long long)drop;
+        }
+        return out;
+    }
+
+private:
+    uint32_t Hash(size_t i) const {
+        uint32_t v;
+        memcpy(&v, &hist[i], 4);
+        return (v * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+    }
+
+    static void PutLength(std::string& out, size_t n) {
+        while (n >= 255) { out += (char)255; n -= 255; }
+        out += (char)n;
+    }
+
+    // One sequence: literals, then (unless last) a match.
+    void Emit(std::string& out, size_t litPos, size_t litLen, size_t offset, size_t matchLen) {
+        size_t ml = matchLen ? matchLen - COMPRESS_MIN_MATCH : 0;
+        out += (char)(((litLen < 15 ? litLen : 15) << 4) | (ml < 15 ? ml : 15));
+        if (litLen >= 15) PutLength(out, litLen - 15);
+        out.append(hist, litPos, litLen);
+        if (!matchLen) return;
+
+        out += (char)(offset & 0xff);
+        out += (char)(offset >> 8);
+        if (ml >= 15) PutLength(out, ml - 15);
+    }
+
+    std::string hist;               // dictionary + recent plaintext
+    std::vector<long long> table;   // hash -> absolute position (base + index)
+    long long base;                 // absolute position of hist[0]
+};
+
+// -------------------- Decoder --------------------
+class ChatDecoder {
+public:
+    ChatDecoder() { Reset(); }
+
+    void Reset() { hist = ChatDictionary(); }
+    void Prime(const std::string& snapshot) { hist = snapshot; }
+
+    // Appends the decoded message to `out`. False on corrupt input
+    // or a message longer than `limit`; the decoder is unusable after.
+    bool Decompress(const std::string& in, std::string& out, size_t limit = MAX_FRAME_PAYLOAD) {
+        size_t start = hist.size(), p = 0;
+        while (p < in.size()) {
+            unsigned char token = (unsigned char)in[p++];
+
+            size_t lit = token >> 4;
+            if (lit == 15 && !GetLength(in, p, lit)) return false;
+            if (in.size() - p < lit) return false;
+            if (hist.size() - start + lit > limit) return false;
+            hist.append(in, p, lit);
+            p += lit;
+            if (p == in.size()) break;      // last sequence has no match
+
+            if (in.size() - p < 2) return false;
+            size_t offset = (unsigned char)in[p] | ((size_t)(unsigned char)in[p + 1] << 8);
+            p += 2;
+            size_t m = token & 15;
+            if (m == 15 && !GetLength(in, p, m)) return false;
+            m += COMPRESS_MIN_MATCH;
+
+            if (offset == 0 || offset > hist.size()) return false;
+            if (hist.size() - start + m > limit) return false;
+            size_t from = hist.size() - offset;
+            for (size_t k = 0; k < m; k++) hist += hist[from + k];  // may overlap
+        }
+
+        out.append(hist, start, std::string::npos);
+        if (hist.size() > 2 * COMPRESS_WINDOW) hist.erase(0, hist.size() - COMPRESS_WINDOW);
+        return true;
+    }
+
+private:
+    static bool GetLength(const std::string& in, size_t& p, size_t& n) {
+        while (true) {
+            if (p >= in.size()) return false;
+            unsigned char b = (unsigned char)in[p++];
+            n += b;
+            if (n > MAX_FRAME_PAYLOAD) return false;
+            if (b != 255) return true;
+        }
+    }
+
+    std::string hist;
+};
+
+#endif
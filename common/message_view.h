@@ -0,0 +1,94 @@
+#ifndef MESSAGE_VIEW_H
+#define MESSAGE_VIEW_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <cstddef>
+
+/*
+========================================================
+MESSAGE VIEW MODEL (shared by all chat GUIs)
+--------------------------------------------------------
+- Fixed-capacity ring of the most recent messages
+- Any thread may Push(); only the UI thread calls Flush()
+- Pushes between two flushes are coalesced into one batch,
+  so the GUI touches its log control once per frame
+  instead of once per message
+- Flush() reports how many lines fell off the front and
+  how many characters they held, so a text control can be
+  trimmed by characters (word-wrapped display lines don't
+  match log lines) and stays the same size
+- No Win32 code here, so it can be used headless
+========================================================
+*/
+
+#define MAX_LOG_LINES 500
+#define LOG_LINE_END "\r\n"     // between lines in a text control (see message_view_win32.h)
+
+class MessageView {
+public:
+    struct Batch {
+        std::vector<std::string> added;   // lines to append, oldest first
+        size_t evicted = 0;               // lines to remove from the top
+        size_t evictedChars = 0;          // their text length, without separators
+    };
+
+    explicit MessageView(size_t capacity = MAX_LOG_LINES)
+        : ring(capacity ? capacity : 1), head(0), count(0) {}
+
+    // Queue a line for the next flush. Returns true when this is the
+    // first pending line, i.e. the caller should schedule a flush.
+    bool Push(const char* text) {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool first = pending.empty();
+
+        // Anything older than Capacity() lines would be evicted on the
+        // next flush anyway, so a stalled UI never queues more than that.
+        if (pending.size() == ring.size()) pending.pop_front();
+        pending.emplace_back(text);
+        return first;
+    }
+
+    // Move pending lines into the ring. UI thread only.
+    Batch Flush() {
+        Batch b;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            b.added.assign(std::make_move_iterator(pending.begin()),
+                           std::make_move_iterator(pending.end()));
+            pending.clear();
+        }
+
+        size_t total = count + b.added.size();
+        b.evicted = total > ring.size() ? total - ring.size() : 0;
+
+        // Push() keeps at most Capacity() pending lines, so everything
+        // evicted is an older line the control is already showing.
+        for (size_t i = 0; i < b.evicted; i++) b.evictedChars += At(i).size();
+
+        for (const std::string& line : b.added) {
+            ring[(head + count) % ring.size()] = line;
+            if (count == ring.size()) head = (head + 1) % ring.size();
+            else count++;
+        }
+        return b;
+    }
+
+    size_t Size() const { return count; }
+    size_t Capacity() const { return ring.size(); }
+
+    // i = 0 is the oldest line still held. UI thread only.
+    const std::string& At(size_t i) const { return ring[(head + i) % ring.size()]; }
+
+private:
+    std::vector<std::string> ring;
+    size_t head, count;
+
+    std::mutex mtx;
+    std::deque<std::string> pending;
+};
+
+#endif
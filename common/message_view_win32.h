@@ -0,0 +1,70 @@
+#ifndef MESSAGE_VIEW_WIN32_H
+#define MESSAGE_VIEW_WIN32_H
+
+#include <windows.h>
+#include <string>
+#include <cstring>
+
+#include "message_view.h"
+
+/*
+========================================================
+MESSAGE VIEW -> WIN32 CONTROLS (shared by all chat GUIs)
+--------------------------------------------------------
+- Applies one MessageView::Flush() batch to the control
+  that shows it: a read-only multiline EDIT (socket GUIs)
+  or a LISTBOX (shared-memory GUIs)
+- UI thread only, like Flush(); call from the WM_APP_*
+  handler that the view's first Push() posted
+- Redraw is off while the control changes, so a batch
+  costs one repaint
+========================================================
+*/
+
+// Lines that fell out of the ring are cut from the front so the control
+// stays bounded. Cut by characters: long lines wrap, so EM_LINEINDEX
+// counts display lines, not log lines.
+inline void FlushToEdit(MessageView& view, HWND edit) {
+    MessageView::Batch b = view.Flush();
+    if (b.added.empty()) return;
+
+    std::string text;
+    for (const std::string& line : b.added) text += line + LOG_LINE_END;
+
+    SendMessageA(edit, WM_SETREDRAW, FALSE, 0);
+
+    if (b.evicted) {
+        int cut = (int)(b.evictedChars + b.evicted * strlen(LOG_LINE_END));
+        SendMessageA(edit, EM_SETSEL, 0, cut);
+        SendMessageA(edit, EM_REPLACESEL, 0, (LPARAM)"");
+    }
+
+    int len = GetWindowTextLengthA(edit);
+    SendMessageA(edit, EM_SETSEL, len, len);
+    SendMessageA(edit, EM_REPLACESEL, 0, (LPARAM)text.c_str());
+
+    SendMessageA(edit, WM_SETREDRAW, TRUE, 0);
+    SendMessageA(edit, EM_SCROLLCARET, 0, 0);
+    InvalidateRect(edit, NULL, TRUE);
+}
+
+// A listbox holds one item per line, so evicted lines are whole items.
+inline void FlushToListBox(MessageView& view, HWND list) {
+    MessageView::Batch b = view.Flush();
+    if (b.added.empty()) return;
+
+    SendMessageA(list, WM_SETREDRAW, FALSE, 0);
+
+    for (size_t i = 0; i < b.evicted; i++)
+        SendMessageA(list, LB_DELETESTRING, 0, 0);
+    for (const std::string& line : b.added)
+        SendMessageA(list, LB_ADDSTRING, 0, (LPARAM)line.c_str());
+
+    int count = (int)SendMessageA(list, LB_GETCOUNT, 0, 0);
+    SendMessageA(list, LB_SETTOPINDEX, count - 1, 0);
+
+    SendMessageA(list, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(list, NULL, TRUE);
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include "../message_view.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/*
+========================================================
+MESSAGE VIEW TESTS (headless)
+--------------------------------------------------------
+- Plays the EDIT control with a std::string and applies
+  every Flush() batch the way FlushToEdit() does: cut
+  evictedChars + one separator per evicted line from the
+  front, append the new lines
+- Checks the "control" always holds exactly the ring,
+  with lines long enough that a real control would wrap
+- Pushes millions of messages and checks memory and the
+  characters the control has to move per message stay
+  flat (time is printed, not checked: it depends on
+  the machine's load)
+- Build and run: make -C common/tests
+========================================================
+*/
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+// What FlushToEdit() does to the EDIT control, on a string.
+struct FakeControl {
+    std::string text;
+    unsigned long long moved = 0;   // characters cut and appended so far
+
+    void Apply(const MessageView::Batch& b) {
+        size_t cut = b.evictedChars + b.evicted * strlen(LOG_LINE_END);
+        text.erase(0, cut);
+        moved += cut;
+        for (const std::string& line : b.added) {
+            text += line + LOG_LINE_END;
+            moved += line.size() + strlen(LOG_LINE_END);
+        }
+    }
+};
+
+static std::string Expected(const MessageView& v) {
+    std::string all;
+    for (size_t i = 0; i < v.Size(); i++) all += v.At(i) + LOG_LINE_END;
+    return all;
+}
+
+// Resident set size in KB, from /proc (Linux only).
+static long RssKb() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    long pages = 0, rss = 0;
+    if (fscanf(f, "%ld %ld", &pages, &rss) != 2) rss = 0;
+    fclose(f);
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static std::string Line(unsigned n, size_t len) {
+    std::string s = "msg " + std::to_string(n) + " ";
+    s.resize(len > s.size() ? len : s.size(), 'a' + n % 26);
+    return s;
+}
+
+// -------------------- Tests --------------------
+static void TestBatching() {
+    MessageView v(4);
+    CHECK(v.Push("a"));         // first pending line asks for a flush
+    CHECK(!v.Push("b"));
+    CHECK(!v.Push("c"));
+
+    MessageView::Batch b = v.Flush();
+    CHECK(b.added.size() == 3);
+    CHECK(b.evicted == 0 && b.evictedChars == 0);
+    CHECK(v.Flush().added.empty());
+
+    v.Push("dd");
+    v.Push("eee");
+    b = v.Flush();
+    CHECK(b.added.size() == 2);
+    CHECK(b.evicted == 1);
+    CHECK(b.evictedChars == 1);     // "a"
+    CHECK(v.Size() == 4 && v.At(0) == "b" && v.At(3) == "eee");
+}
+
+static void TestStalledUi() {
+    MessageView v(100);
+    FakeControl ctl;
+    for (unsigned i = 0; i < 50; i++) v.Push(Line(i, 10).c_str());
+    ctl.Apply(v.Flush());
+
+    // UI blocked while 10x capacity arrives: only the newest survive
+    for (unsigned i = 50; i < 1050; i++) v.Push(Line(i, 10).c_str());
+    MessageView::Batch b = v.Flush();
+    CHECK(b.added.size() == 100);
+    CHECK(b.evicted == 50);
+    ctl.Apply(b);
+    CHECK(ctl.text == Expected(v));
+    CHECK(v.At(0) == Line(950, 10));
+}
+
+// Lines of random length, many far wider than any log window.
+static void TestCharTrimWithLongLines() {
+    MessageView v(50);
+    FakeControl ctl;
+    srand(7);
+    for (unsigned i = 0; i < 20000; i++) {
+        v.Push(Line(i, rand() % 3 == 0 ? 200 + rand() % 2000 : rand() % 40).c_str());
+        if (rand() % 8 == 0) {
+            ctl.Apply(v.Flush());
+            if (ctl.text != Expected(v)) {
+                CHECK(ctl.text == Expected(v));
+                return;
+            }
+        }
+    }
+    ctl.Apply(v.Flush());
+    CHECK(ctl.text == Expected(v));
+    CHECK(v.Size() == 50);
+}
+
+// Millions of messages: memory and work per message must not grow.
+static void TestConstantCost() {
+    const unsigned CHUNK = 1000000, CHUNKS = 5;
+    MessageView v;
+    FakeControl ctl;
+    size_t maxText = 0;
+    long rssAfterFirst = 0;
+    double firstMoved = 0, lastMoved = 0;
+
+    unsigned n = 0;
+    for (unsigned c = 0; c < CHUNKS; c++) {
+        auto t0 = std::chrono::steady_clock::now();
+        unsigned long long movedBefore = ctl.moved;
+        for (unsigned i = 0; i < CHUNK; i++, n++) {
+            v.Push(Line(n, n % 100).c_str());
+            if (n % 64 == 63) ctl.Apply(v.Flush());     // roughly one flush per frame
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / CHUNK;
+        double moved = (double)(ctl.moved - movedBefore) / CHUNK;
+        if (ctl.text.size() > maxText) maxText = ctl.text.size();
+
+        if (c == 1) { firstMoved = moved; rssAfterFirst = RssKb(); }   // chunk 0 is warm-up
+        if (c == CHUNKS - 1) lastMoved = moved;
+        printf("  %u M messages: %.0f ns/msg, %.1f chars moved/msg, rss %ld KB, control %zu chars\n",
+            c + 1, ns, moved, RssKb(), ctl.text.size());
+    }
+
+    CHECK(v.Size() == MAX_LOG_LINES);
+    CHECK(maxText <= MAX_LOG_LINES * (100 + strlen(LOG_LINE_END)));
+    CHECK(ctl.text == Expected(v));
+    CHECK(RssKb() - rssAfterFirst < 1024);
+    CHECK(lastMoved <= firstMoved * 1.01);
+    CHECK(lastMoved <= 2 * (100 + strlen(LOG_LINE_END)));     // each line in once, out once
+}
+
+// Several producers, one UI thread flushing as it goes.
+static void TestConcurrentPush() {
+    const int THREADS = 4, PER_THREAD = 200000;
+    MessageView v(1000);
+    FakeControl ctl;
+    std::atomic<int> finished(0);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < THREADS; t++)
+        producers.emplace_back([&, t] {
+            for (int i = 0; i < PER_THREAD; i++)
+                v.Push((std::to_string(t) + " " + std::to_string(i)).c_str());
+            finished++;
+        });
+
+    while (finished < THREADS) ctl.Apply(v.Flush());
+    for (auto& p : producers) p.join();
+    ctl.Apply(v.Flush());
+
+    CHECK(ctl.text == Expected(v));
+    CHECK(v.Size() == 1000);
+
+    // Each producer's lines stay in order
+    int last[THREADS] = {};
+    bool ordered = true;
+    for (size_t i = 0; i < v.Size(); i++) {
+        int t = 0, n = 0;
+        sscanf(v.At(i).c_str(), "%d %d", &t, &n);
+        if (n < last[t]) ordered = false;
+        last[t] = n;
+    }
+    CHECK(ordered);
+}
+
+int main() {
+    TestBatching();
+    TestStalledUi();
+    TestCharTrimWithLongLines();
+    TestConcurrentPush();
+    TestConstantCost();
+
+    if (failures) {
+        printf("message_view: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("message_view: all tests passed\n");
+    return 0;
+}
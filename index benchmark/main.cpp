@@ -0,0 +1,166 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+
+#include "../server chat socket and multithreading/chat_index.h"
+
+/*
+========================================================
+SEARCH INDEX BENCHMARK (console)
+--------------------------------------------------------
+Fills a ChatIndex with synthetic chat history and times
+it the way the server uses it:
+
+  build   Add() rate, and p50 / p99 / max time of one
+          Add() (it runs under historyMtx in Record,
+          right after each broadcast)
+  query   p50 / max latency of typical searches: common
+          and rare words, ANDs, phrases, from:N, last:M;
+          "partial" when a phrase query stopped at
+          MAX_PHRASE_CHECKS candidates
+
+Word frequencies follow a Zipf curve over a few thousand
+words, with a handful of fixed phrases and names mixed
+in, at 100 messages per second ending "now" so last:M
+ranges line up with the real clock.
+
+No Win32 code: also builds with
+  g++ -O2 -std=c++11 main.cpp -o indexbench
+
+Usage: indexbench [messages]   (default 5000000)
+========================================================
+*/
+
+#define VOCABULARY     5000
+#define MSGS_PER_SEC   100
+#define SENDERS        200
+#define QUERY_RUNS     20
+#define ADD_SAMPLE     16       // time every Nth Add()
+
+typedef std::chrono::steady_clock Clock;
+
+double Ms(Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// xorshift, so generating the corpus costs little next to Add()
+unsigned long long rng = 88172645463325252ULL;
+
+unsigned long long Rand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+// -------------------- Corpus --------------------
+const char* commonWords[] = {
+    "the", "hello", "lunch", "today", "meeting", "tomorrow", "thanks", "build",
+    "review", "deploy", "coffee", "later", "ok", "yes", "no", "please", "bug", "fixed"
+};
+
+struct Corpus {
+    std::vector<std::string> words;
+    std::vector<double> cdf;
+
+    Corpus() {
+        for (const char* w : commonWords) words.push_back(w);
+        while (words.size() < VOCABULARY) words.push_back("w" + std::to_string(words.size()));
+
+        double sum = 0;
+        for (size_t r = 1; r <= words.size(); r++) {
+            sum += 1.0 / r;
+            cdf.push_back(sum);
+        }
+        for (double& c : cdf) c /= sum;
+    }
+
+    const std::string& Word() {
+        double u = (Rand() >> 11) * (1.0 / 9007199254740992.0);
+        return words[std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()];
+    }
+
+    std::string Message(unsigned long long i) {
+        std::string m;
+        int n = 3 + (int)(Rand() % 10);
+        for (int k = 0; k < n; k++) {
+            if (k) m += ' ';
+            m += Word();
+        }
+        if (i % 100 == 7) m += " the build is broken";
+        if (i % 100000 == 13) m += " zebra";
+        return m;
+    }
+};
+
+// -------------------- main --------------------
+int main(int argc, char** argv) {
+    long long count = argc > 1 ? atoll(argv[1]) : 5000000;
+    if (count <= 0) count = 5000000;
+
+    Corpus corpus;
+    ChatIndex index;
+    time_t start = time(NULL) - (time_t)(count / MSGS_PER_SEC);
+
+    // ---- build ----
+    std::vector<double> addUs;
+    addUs.reserve((size_t)(count / ADD_SAMPLE + 1));
+    Clock::duration inAdd = Clock::duration::zero();
+    std::string msg;
+
+    for (long long i = 0; i < count; i++) {
+        msg = corpus.Message(i);
+        time_t when = start + (time_t)(i / MSGS_PER_SEC);
+        int sender = 1 + (int)(Rand() % SENDERS);
+
+        Clock::time_point t0 = Clock::now();
+        index.Add(sender, msg.c_str(), when);
+        Clock::duration d = Clock::now() - t0;
+
+        inAdd += d;
+        if (i % ADD_SAMPLE == 0) addUs.push_back(Ms(d) * 1000);
+        if ((i + 1) % 10000000 == 0) printf("  %lld M indexed\n", (i + 1) / 1000000);
+    }
+
+    std::sort(addUs.begin(), addUs.end());
+    printf("build: %lld messages, %.0f adds/s, add p50 %.2f us, p99 %.2f us, max %.0f us\n\n",
+        count, count / (Ms(inAdd) / 1000),
+        addUs[addUs.size() / 2], addUs[addUs.size() * 99 / 100], addUs.back());
+
+    // ---- query ----
+    const char* queries[] = {
+        "hello",                    // very common
+        "zebra",                    // rare
+        "lunch today",
+        "hello zebra",
+        "\"build is broken\"",
+        "\"hello the\"",            // common words, rare as a phrase
+        "\"hello, the\"",           // common words, never as a phrase: checks the most candidates
+        "from:7",
+        "from:7 lunch",
+        "last:5",
+        "lunch last:60",
+        "zebra last:1",             // nothing that recent
+        "w4000 w4999",              // two of the rarest vocabulary words
+    };
+
+    printf("%-22s %8s %10s %10s\n", "query", "hits", "p50 ms", "max ms");
+    for (const char* q : queries) {
+        std::vector<double> ms;
+        ChatIndex::Result res;
+        for (int r = 0; r < QUERY_RUNS; r++) {
+            Clock::time_point t0 = Clock::now();
+            res = index.Search(q, 20);
+            ms.push_back(Ms(Clock::now() - t0));
+        }
+        std::sort(ms.begin(), ms.end());
+        printf("%-22s %8zu %10.3f %10.3f%s\n", q, res.ids.size(), ms[ms.size() / 2], ms.back(),
+            res.partial ? "   partial" : "");
+    }
+    return 0;
+}
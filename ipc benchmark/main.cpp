@@ -0,0 +1,558 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+
+#include "../common/chat_compress.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+/*
+========================================================
+IPC BENCHMARK (console)
+--------------------------------------------------------
+Drives the same chat-like workload through the three
+same-host transports we could deploy:
+
+  shm   ring in a file mapping guarded by a mutex, with
+        events for "data" and "space" (the ShmData design)
+  tcp   TCP over 127.0.0.1
+  unix  AF_UNIX stream sockets (Windows 10 1803+)
+
+Every consumer receives every producer's messages, as in
+a chat room. Each run varies message size, producer and
+consumer counts, and batch size (messages per lock or per
+send() call). Reported per run:
+  - deliveries per second and MB/s
+  - p50 / p99 latency, send to receive, in microseconds
+  - process CPU time per delivered message
+
+A last table runs chat-like text through the socket
+chat's compressor (common/chat_compress.h): bytes on
+the wire vs raw, and CPU per message to encode/decode.
+
+-train builds a compression dictionary from a chat log
+(one message per line) instead: it trains on the first
+80% of the lines, compares built-in and trained on the
+rest, and writes the trained one for the chat programs
+to load. Copy it next to every client and server; ends
+with different dictionaries stay uncompressed.
+
+Usage: ipcbench [messages per producer]   (default 20000)
+       ipcbench -train log.txt [out]      (default out: chat.dict)
+========================================================
+*/
+
+#define BENCH_SHM_NAME   "Local\\IpcBenchMemory"
+#define BENCH_MUTEX_NAME "Local\\IpcBenchMutex"
+#define BENCH_SPACE_NAME "Local\\IpcBenchSpace"
+
+#define RING_SLOTS    256
+#define SLOT_SIZE     1024
+#define MAX_CONSUMERS 8
+
+struct MsgHeader {
+    long long sentAt;       // QueryPerformanceCounter at send
+    unsigned producer;
+    unsigned seq;
+};
+
+struct RunConfig {
+    const char* transport;
+    int msgSize;
+    int producers;
+    int consumers;
+    int batch;
+    int perProducer;
+};
+
+struct RunResult {
+    double seconds;
+    unsigned long long deliveries;
+    double p50us, p99us;
+    double cpuUsPerMsg;
+};
+
+long long qpcFreq;
+
+long long Now() {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+double CpuSeconds() {
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    auto secs = [](FILETIME f) {
+        return (((unsigned long long)f.dwHighDateTime << 32) | f.dwLowDateTime) / 1e7;
+    };
+    return secs(kernel) + secs(user);
+}
+
+void FillMessage(char* dst, int size, unsigned producer, unsigned seq) {
+    MsgHeader h = { Now(), producer, seq };
+    memcpy(dst, &h, sizeof(h));
+    memset(dst + sizeof(h), 'x', size - sizeof(h));
+}
+
+// Latency of one received message, in QPC ticks.
+long long Age(const char* msg) {
+    MsgHeader h;
+    memcpy(&h, msg, sizeof(h));
+    return Now() - h.sentAt;
+}
+
+// -------------------- Shared-memory ring --------------------
+// Same layout idea as the chat's ShmData (seq + fixed slots), plus a
+// read cursor per consumer so producers wait instead of overwriting.
+struct BenchShm {
+    unsigned long long seq;
+    unsigned long long readSeq[MAX_CONSUMERS];
+    char msgs[RING_SLOTS][SLOT_SIZE];
+};
+
+struct ShmRing {
+    HANDLE hMap, hMutex, hSpace;
+    HANDLE hData[MAX_CONSUMERS];
+    BenchShm* shm;
+    int consumers;
+};
+
+void ShmOpen(ShmRing& r, int consumers) {
+    r.hMap   = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(BenchShm), BENCH_SHM_NAME);
+    r.shm    = (BenchShm*)MapViewOfFile(r.hMap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(BenchShm));
+    r.hMutex = CreateMutexA(NULL, FALSE, BENCH_MUTEX_NAME);
+    r.hSpace = CreateEventA(NULL, TRUE, FALSE, BENCH_SPACE_NAME);
+    for (int c = 0; c < consumers; c++) r.hData[c] = CreateEventA(NULL, FALSE, FALSE, NULL);
+    r.consumers = consumers;
+    memset(r.shm, 0, sizeof(BenchShm));
+}
+
+void ShmClose(ShmRing& r) {
+    for (int c = 0; c < r.consumers; c++) CloseHandle(r.hData[c]);
+    CloseHandle(r.hSpace);
+    CloseHandle(r.hMutex);
+    UnmapViewOfFile(r.shm);
+    CloseHandle(r.hMap);
+}
+
+void ShmProducer(ShmRing* r, const RunConfig* cfg, unsigned id) {
+    int sent = 0;
+    while (sent < cfg->perProducer) {
+        WaitForSingleObject(r->hMutex, INFINITE);
+
+        unsigned long long minRead = r->shm->readSeq[0];
+        for (int c = 1; c < r->consumers; c++) minRead = std::min(minRead, r->shm->readSeq[c]);
+        int room = RING_SLOTS - (int)(r->shm->seq - minRead);
+
+        if (room == 0) {
+            // Reset under the lock; consumers set it under the lock too
+            ResetEvent(r->hSpace);
+            ReleaseMutex(r->hMutex);
+            WaitForSingleObject(r->hSpace, INFINITE);
+            continue;
+        }
+
+        int n = std::min(std::min(room, cfg->batch), cfg->perProducer - sent);
+        for (int i = 0; i < n; i++) {
+            r->shm->seq++;
+            FillMessage(r->shm->msgs[r->shm->seq % RING_SLOTS], cfg->msgSize, id, sent++);
+        }
+
+        ReleaseMutex(r->hMutex);
+        for (int c = 0; c < r->consumers; c++) SetEvent(r->hData[c]);
+    }
+}
+
+void ShmConsumer(ShmRing* r, const RunConfig* cfg, int id, std::vector<long long>* lat) {
+    unsigned long long expected = (unsigned long long)cfg->producers * cfg->perProducer;
+    unsigned long long got = 0;
+    while (got < expected) {
+        WaitForSingleObject(r->hData[id], INFINITE);
+        WaitForSingleObject(r->hMutex, INFINITE);
+
+        unsigned long long& lastSeq = r->shm->readSeq[id];
+        while (lastSeq < r->shm->seq) {
+            lastSeq++;
+            lat->push_back(Age(r->shm->msgs[lastSeq % RING_SLOTS]));
+            got++;
+        }
+
+        SetEvent(r->hSpace);
+        ReleaseMutex(r->hMutex);
+    }
+}
+
+// -------------------- Stream sockets (tcp / unix) --------------------
+bool SendAll(SOCKET s, const char* data, int len) {
+    while (len > 0) {
+        int n = send(s, data, len, 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// One connection per (producer, consumer) pair; producers send each
+// batch with one send() per consumer, like Broadcast does.
+void StreamProducer(std::vector<SOCKET> socks, const RunConfig* cfg, unsigned id) {
+    std::vector<char> batch((size_t)cfg->batch * cfg->msgSize);
+    int sent = 0;
+    while (sent < cfg->perProducer) {
+        int n = std::min(cfg->batch, cfg->perProducer - sent);
+        for (int i = 0; i < n; i++) FillMessage(&batch[(size_t)i * cfg->msgSize], cfg->msgSize, id, sent++);
+        for (SOCKET s : socks) SendAll(s, batch.data(), n * cfg->msgSize);
+    }
+}
+
+void StreamConsumer(std::vector<SOCKET> socks, const RunConfig* cfg, std::vector<long long>* lat) {
+    unsigned long long expected = (unsigned long long)cfg->producers * cfg->perProducer;
+    unsigned long long got = 0;
+    std::vector<std::string> partial(socks.size());
+    std::vector<char> buffer(64 * 1024);
+
+    while (got < expected) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        for (SOCKET s : socks) FD_SET(s, &fds);
+        if (select(0, &fds, NULL, NULL, NULL) <= 0) break;
+
+        for (size_t i = 0; i < socks.size(); i++) {
+            if (!FD_ISSET(socks[i], &fds)) continue;
+            int n = recv(socks[i], buffer.data(), (int)buffer.size(), 0);
+            if (n <= 0) return;
+
+            std::string& in = partial[i];
+            in.append(buffer.data(), n);
+            size_t used = 0;
+            while (in.size() - used >= (size_t)cfg->msgSize) {
+                lat->push_back(Age(in.data() + used));
+                used += cfg->msgSize;
+                got++;
+            }
+            in.erase(0, used);
+        }
+    }
+}
+
+// Returns [pair p*C + c] = {producer end, consumer end}.
+bool StreamConnect(bool unixSocket, int pairs, std::vector<SOCKET>& prodEnds, std::vector<SOCKET>& consEnds) {
+    int family = unixSocket ? AF_UNIX : AF_INET;
+    SOCKET listener = socket(family, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) return false;
+
+    sockaddr_storage addr{};
+    int addrLen;
+    if (unixSocket) {
+        sockaddr_un* un = (sockaddr_un*)&addr;
+        un->sun_family = AF_UNIX;
+        char dir[MAX_PATH];
+        GetTempPathA(MAX_PATH, dir);
+        snprintf(un->sun_path, sizeof(un->sun_path), "%sipcbench.sock", dir);
+        DeleteFileA(un->sun_path);
+        addrLen = sizeof(sockaddr_un);
+    } else {
+        sockaddr_in* in = (sockaddr_in*)&addr;
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        in->sin_port = 0;
+        addrLen = sizeof(sockaddr_in);
+    }
+
+    if (bind(listener, (sockaddr*)&addr, addrLen) == SOCKET_ERROR ||
+        listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+        closesocket(listener);
+        return false;
+    }
+    if (!unixSocket) getsockname(listener, (sockaddr*)&addr, &addrLen);
+
+    for (int i = 0; i < pairs; i++) {
+        SOCKET c = socket(family, SOCK_STREAM, 0);
+        if (connect(c, (sockaddr*)&addr, addrLen) == SOCKET_ERROR) {
+            closesocket(c);
+            closesocket(listener);
+            return false;
+        }
+        SOCKET a = accept(listener, NULL, NULL);
+        if (!unixSocket) {
+            int one = 1;
+            setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+        }
+        prodEnds.push_back(c);
+        consEnds.push_back(a);
+    }
+
+    closesocket(listener);
+    if (unixSocket) DeleteFileA(((sockaddr_un*)&addr)->sun_path);
+    return true;
+}
+
+// -------------------- Runs --------------------
+bool Run(const RunConfig& cfg, RunResult& res) {
+    std::vector<std::vector<long long>> lat(cfg.consumers);
+    for (auto& l : lat) l.reserve((size_t)cfg.producers * cfg.perProducer);
+
+    std::vector<std::thread> threads;
+    ShmRing ring{};
+    std::vector<SOCKET> prodEnds, consEnds;
+    bool shm = strcmp(cfg.transport, "shm") == 0;
+
+    if (shm) {
+        ShmOpen(ring, cfg.consumers);
+    } else if (!StreamConnect(strcmp(cfg.transport, "unix") == 0,
+                              cfg.producers * cfg.consumers, prodEnds, consEnds)) {
+        return false;
+    }
+
+    double cpu0 = CpuSeconds();
+    long long t0 = Now();
+
+    for (int c = 0; c < cfg.consumers; c++) {
+        if (shm) {
+            threads.emplace_back(ShmConsumer, &ring, &cfg, c, &lat[c]);
+        } else {
+            std::vector<SOCKET> mine;
+            for (int p = 0; p < cfg.producers; p++) mine.push_back(consEnds[p * cfg.consumers + c]);
+            threads.emplace_back(StreamConsumer, mine, &cfg, &lat[c]);
+        }
+    }
+    for (int p = 0; p < cfg.producers; p++) {
+        if (shm) {
+            threads.emplace_back(ShmProducer, &ring, &cfg, (unsigned)p);
+        } else {
+            std::vector<SOCKET> mine(prodEnds.begin() + p * cfg.consumers,
+                                     prodEnds.begin() + (p + 1) * cfg.consumers);
+            threads.emplace_back(StreamProducer, mine, &cfg, (unsigned)p);
+        }
+    }
+    for (auto& t : threads) t.join();
+
+    long long t1 = Now();
+    double cpu1 = CpuSeconds();
+
+    if (shm) ShmClose(ring);
+    for (SOCKET s : prodEnds) closesocket(s);
+    for (SOCKET s : consEnds) closesocket(s);
+
+    std::vector<long long> all;
+    for (auto& l : lat) all.insert(all.end(), l.begin(), l.end());
+    if (all.empty()) return false;
+    std::sort(all.begin(), all.end());
+
+    res.seconds = (double)(t1 - t0) / qpcFreq;
+    res.deliveries = all.size();
+    res.p50us = all[all.size() / 2] * 1e6 / qpcFreq;
+    res.p99us = all[all.size() * 99 / 100] * 1e6 / qpcFreq;
+    res.cpuUsPerMsg = (cpu1 - cpu0) * 1e6 / all.size();
+    return true;
+}
+
+// -------------------- Compression --------------------
+// Synthetic chat: a few names, the server's own prefixes and
+// common phrases, with numbers so no two messages are identical.
+std::vector<std::string> ChatCorpus(int count) {
+    const char* names[]   = { "alice", "bob", "carol", "dave", "erin" };
+    const char* phrases[] = { "hello everyone", "are we still on for lunch today?",
+                              "the build is broken again", "ok thanks, see you later",
+                              "can you review my change when you have time", "good morning" };
+    std::vector<std::string> msgs;
+    unsigned r = 12345;
+    for (int i = 0; i < count; i++) {
+        r = r * 1103515245 + 12345;
+        std::string m = std::string("Client ") + std::to_string(r % 40) + ": " +
+                        names[(r >> 8) % 5] + ": " + phrases[(r >> 12) % 6];
+        if ((r >> 16) % 3 == 0) m += " #" + std::to_string(i);
+        msgs.push_back(m);
+    }
+    return msgs;
+}
+
+void CompressionReport(const std::vector<std::string>& msgs) {
+    size_t count = msgs.size();
+    unsigned long long raw = 0;
+    for (const std::string& m : msgs) raw += m.size();
+
+    printf("\n%-22s %10s %10s %7s %12s %12s\n",
+        "compression", "raw KB", "wire KB", "ratio", "enc us/msg", "dec us/msg");
+
+    // streaming: one context for the whole conversation (what the server does)
+    // per-message: fresh context every time, only the dictionary helps
+    for (int streaming = 1; streaming >= 0; streaming--) {
+        std::vector<std::string> frames;
+        ChatEncoder enc;
+        long long t0 = Now();
+        for (const std::string& m : msgs) {
+            if (!streaming) enc.Reset();
+            std::string f;
+            AppendFrame(f, FRAME_MSG, enc.Compress(m.data(), m.size()));
+            frames.push_back(f);
+        }
+        long long t1 = Now();
+
+        ChatDecoder dec;
+        unsigned long long wire = 0;
+        bool ok = true;
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (!streaming) dec.Reset();
+            size_t pos = 0;
+            int flag;
+            std::string payload, text;
+            ok = ok && ParseFrame(frames[i], pos, flag, payload) == 1 &&
+                 dec.Decompress(payload, text) && text == msgs[i];
+            wire += frames[i].size();
+        }
+        long long t2 = Now();
+
+        printf("%-22s %10.1f %10.1f %6.0f%% %12.2f %12.2f%s\n",
+            streaming ? "streaming + dict" : "per-message + dict",
+            raw / 1024.0, wire / 1024.0, 100.0 * wire / raw,
+            (t1 - t0) * 1e6 / qpcFreq / count, (t2 - t1) * 1e6 / qpcFreq / count,
+            ok ? "" : "   (ROUND TRIP FAILED)");
+    }
+}
+
+// -------------------- Dictionary training --------------------
+#define MAX_TRAIN_MESSAGES 50000
+#define MAX_PIECE 48
+
+// Candidate pieces start at a word and end after one, and score the
+// bytes they'd save if every copy after the first became a 3-byte
+// match. Best pieces go last: they stay in the window longest once
+// live chat starts pushing the dictionary out.
+std::string TrainDictionary(const std::vector<std::string>& msgs, size_t maxBytes) {
+    std::unordered_map<std::string, unsigned> counts;
+    size_t n = msgs.size() < MAX_TRAIN_MESSAGES ? msgs.size() : MAX_TRAIN_MESSAGES;
+    for (size_t k = 0; k < n; k++) {
+        const std::string& m = msgs[k];
+        for (size_t i = 0; i < m.size(); i++) {
+            if (i && m[i - 1] != ' ') continue;
+            for (size_t j = i + COMPRESS_MIN_MATCH; j <= m.size() && j - i <= MAX_PIECE; j++)
+                if (j == m.size() || m[j - 1] == ' ') counts[m.substr(i, j - i)]++;
+        }
+    }
+
+    std::vector<std::pair<unsigned long long, const std::string*>> ranked;
+    for (auto& c : counts)
+        if (c.second > 1)
+            ranked.push_back({ (unsigned long long)(c.second - 1) * (c.first.size() - 3), &c.first });
+    std::sort(ranked.begin(), ranked.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<const std::string*> picked;
+    std::string all;
+    for (auto& r : ranked) {
+        if (all.size() + r.second->size() > maxBytes) continue;
+        if (all.find(*r.second) != std::string::npos) continue;
+        picked.push_back(r.second);
+        all += *r.second;
+    }
+
+    std::string dict;
+    for (size_t i = picked.size(); i-- > 0; ) dict += *picked[i];
+    return dict;
+}
+
+int TrainMain(const char* logPath, const char* outPath) {
+    FILE* f = fopen(logPath, "rb");
+    if (!f) {
+        printf("cannot open %s\n", logPath);
+        return 1;
+    }
+    std::vector<std::string> msgs;
+    std::string line;
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c == '\r') continue;
+        if (c != '\n') { line += (char)c; continue; }
+        if (!line.empty()) msgs.push_back(line + "\n");
+        line.clear();
+    }
+    if (!line.empty()) msgs.push_back(line + "\n");
+    fclose(f);
+    if (msgs.size() < 10) {
+        printf("%s: need at least 10 messages, one per line\n", logPath);
+        return 1;
+    }
+
+    size_t split = msgs.size() * 8 / 10;
+    std::vector<std::string> train(msgs.begin(), msgs.begin() + split);
+    std::vector<std::string> test(msgs.begin() + split, msgs.end());
+    std::string dict = TrainDictionary(train, MAX_DICTIONARY_BYTES);
+    if (dict.empty()) {
+        printf("nothing repeats in %s, keeping the built-in dictionary\n", logPath);
+        return 1;
+    }
+
+    printf("trained on %zu messages, tested on the other %zu\n", train.size(), test.size());
+    printf("\nbuilt-in dictionary (%zu bytes, id %s):", ChatDictionary().size(), ChatDictionaryId().c_str());
+    CompressionReport(test);
+    ChatDictionaryStore() = dict;
+    printf("\ntrained dictionary (%zu bytes, id %s):", dict.size(), ChatDictionaryId().c_str());
+    CompressionReport(test);
+
+    FILE* out = fopen(outPath, "wb");
+    if (!out || fwrite(dict.data(), 1, dict.size(), out) != dict.size()) {
+        printf("\ncannot write %s\n", outPath);
+        if (out) fclose(out);
+        return 1;
+    }
+    fclose(out);
+    printf("\nwrote %s\n", outPath);
+    return 0;
+}
+
+// -------------------- main --------------------
+int main(int argc, char** argv) {
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    qpcFreq = f.QuadPart;
+
+    if (argc > 2 && strcmp(argv[1], "-train") == 0)
+        return TrainMain(argv[2], argc > 3 ? argv[3] : CHAT_DICTIONARY_FILE);
+
+    int perProducer = argc > 1 ? atoi(argv[1]) : 20000;
+    if (perProducer <= 0) perProducer = 20000;
+
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2,2), &wsa);
+
+    const char* transports[] = { "shm", "tcp", "unix" };
+    int sizes[]   = { 32, 256, 1024 };
+    int counts[][2] = { {1, 1}, {4, 1}, {1, 4}, {4, 4} };
+    int batches[] = { 1, 16 };
+
+    printf("%-5s %6s %3s %3s %5s %12s %9s %9s %9s %11s\n",
+        "ipc", "bytes", "P", "C", "batch", "msgs/s", "MB/s", "p50 us", "p99 us", "cpu us/msg");
+
+    for (const char* t : transports)
+        for (int size : sizes)
+            for (auto& pc : counts)
+                for (int batch : batches) {
+                    RunConfig cfg = { t, size, pc[0], pc[1], batch, perProducer };
+                    RunResult r;
+                    if (!Run(cfg, r)) {
+                        printf("%-5s %6d %3d %3d %5d   (unavailable on this system)\n", t, size, pc[0], pc[1], batch);
+                        continue;
+                    }
+                    printf("%-5s %6d %3d %3d %5d %12.0f %9.1f %9.1f %9.1f %11.2f\n",
+                        t, size, pc[0], pc[1], batch,
+                        r.deliveries / r.seconds,
+                        r.deliveries * (double)size / r.seconds / (1024 * 1024),
+                        r.p50us, r.p99us, r.cpuUsPerMsg);
+                }
+
+    CompressionReport(ChatCorpus(perProducer));
+
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,28 @@
+@echo off
+rem One chat server, normal bots, then abusive bots joining halfway through.
+rem Build the Release targets of the server (gui2) and of this project first.
+rem
+rem   abuse.bat [bots] [abusers] [msgs/s per abuser] [seconds]   (default 100 40 5 30)
+rem
+rem The abusers each stay at the per-client limit, but together they push
+rem the room past 200 msg/s. The summary compares the normal bots before
+rem and after they join: with fair sharing their deliveries stay flat.
+rem The server window stays open; its log shows per-client drops.
+
+setlocal
+set SERVER="%~dp0..\server chat socket and multithreading\bin\Release\gui2.exe"
+set LOADTEST="%~dp0bin\Release\loadtest.exe"
+set BOTS=%1
+set ABUSERS=%2
+set ABUSE_RATE=%3
+set SECONDS=%4
+if "%BOTS%"=="" set BOTS=100
+if "%ABUSERS%"=="" set ABUSERS=40
+if "%ABUSE_RATE%"=="" set ABUSE_RATE=5
+if "%SECONDS%"=="" set SECONDS=30
+
+start "node 8080" %SERVER% 8080
+timeout /t 2 /nobreak > nul
+
+%LOADTEST% 127.0.0.1:8080 %BOTS% 1 %SECONDS% -a %ABUSERS% %ABUSE_RATE%
+endlocal
@@ -0,0 +1,31 @@
+@echo off
+rem Three linked chat server nodes on loopback, then bots spread across them.
+rem Build the Release targets of the server (gui2) and of this project first.
+rem
+rem   federation.bat [bots] [msgs/s per bot] [seconds]     (default 300 1 30)
+rem
+rem Keep the totals under the server's rate limits (5 msg/s per client,
+rem 200 msg/s per node) or the run measures the limiter, not the links.
+rem The server windows stay open; their logs show relay stats every 10 s.
+
+setlocal
+set SERVER="%~dp0..\server chat socket and multithreading\bin\Release\gui2.exe"
+set LOADTEST="%~dp0bin\Release\loadtest.exe"
+set BOTS=%1
+set RATE=%2
+set SECONDS=%3
+if "%BOTS%"=="" set BOTS=300
+if "%RATE%"=="" set RATE=1
+if "%SECONDS%"=="" set SECONDS=30
+
+rem 8080 is listed by both others, 8081 by 8082: a full mesh, each link once
+start "node 8080" %SERVER% 8080
+start "node 8081" %SERVER% 8081 127.0.0.1:8080
+start "node 8082" %SERVER% 8082 127.0.0.1:8080, 127.0.0.1:8081
+
+rem The bots wait for a sync message to reach every node, so links only
+rem need to be up by then; this is just a head start
+timeout /t 3 /nobreak > nul
+
+%LOADTEST% 127.0.0.1:8080,127.0.0.1:8081,127.0.0.1:8082 %BOTS% %RATE% %SECONDS%
+endlocal
@@ -0,0 +1,373 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../client chat socket and multithreading/chat_client.h"
+
+/*
+========================================================
+CHAT LOAD TEST (console)
+--------------------------------------------------------
+Many bot clients on one thread, all driven by a single
+ChatLoop from the client library (chat_client.h):
+
+- all bots connect, then bot 0 sends "sync" until every
+  other bot has heard it (a finished connect() only means
+  the server's backlog has it, not that it was accepted)
+- then each bot sends a numbered, timestamped line at a
+  steady rate:
+      lt <bot> <seq> <send time us>
+- every bot parses what the server fans out, so each
+  delivery gives one send-to-receive latency (all bots
+  share this process's clock)
+- once a second: bots up, sends/s, deliveries/s,
+  p50 / p99 latency; at the end the same for the whole
+  run plus delivered vs expected (sent x other bots)
+- lines from the server itself ("Server: ...") are
+  counted as notices, anything else as garbled
+- with several servers (linked nodes), bots are dealt
+  round-robin and latency is also shown for deliveries
+  that crossed to another node; more than 100% of the
+  expected deliveries means a node delivered twice
+- with -a, that many abusive bots join halfway through
+  and send "ab ..." lines at their own rate; the summary
+  then compares the normal bots before and after, so a
+  fair server keeps their deliveries and latency flat
+  (the abusers are what the room-wide limit drops)
+
+Builds on Windows (Code::Blocks) and on Linux:
+  g++ -O2 -std=c++20 main.cpp \
+      "../client chat socket and multithreading/chat_client.cpp" -o loadtest
+
+Usage: loadtest host:port[,host:port...] [bots] [msgs/s per bot] [seconds]
+                [-z] [-a abusers msgs/s]
+       defaults 100 bots, 1 msg/s, 30 s; -z asks for compression
+       (with chat.dict from the working directory, if any)
+       federation.bat starts three linked nodes and runs this,
+       abuse.bat runs 100 normal bots against 40 at 5 msg/s
+========================================================
+*/
+
+#define TICK_MS   5         // pacing granularity for sends
+#define RAMP_MS   1000      // bots start sending spread over this
+#define DRAIN_MS  2000      // wait for late deliveries after the last send
+#define SYNC_MS   250       // bot 0 repeats "sync" this often (under the rate limit)
+#define SYNC_TIMEOUT_MS 30000
+
+typedef std::chrono::steady_clock Clock;
+Clock::time_point epoch = Clock::now();
+
+long long NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - epoch).count();
+}
+
+// -------------------- Latency histogram --------------------
+// Buckets 5% apart, so percentiles cost no per-sample memory.
+#define LAT_BUCKETS 500
+
+struct Latency {
+    unsigned long long buckets[LAT_BUCKETS] = {};
+    unsigned long long count = 0;
+
+    void Add(long long us) {
+        int b = us <= 1 ? 0 : (int)(log((double)us) / log(1.05));
+        buckets[b < LAT_BUCKETS ? b : LAT_BUCKETS - 1]++;
+        count++;
+    }
+
+    // Milliseconds; upper edge of the bucket holding the p-th sample
+    double Percentile(double p) const {
+        if (!count) return 0;
+        unsigned long long want = (unsigned long long)(count * p), seen = 0;
+        for (int b = 0; b < LAT_BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > want) return pow(1.05, b + 1) / 1000;
+        }
+        return pow(1.05, LAT_BUCKETS) / 1000;
+    }
+
+    void Merge(const Latency& o) {
+        for (int b = 0; b < LAT_BUCKETS; b++) buckets[b] += o.buckets[b];
+        count += o.count;
+    }
+};
+
+// Sends and deliveries are the normal bots' own; abusive lines
+// that reach normal bots are counted apart.
+struct Stats {
+    unsigned long long sent = 0, received = 0, notices = 0, garbled = 0;
+    unsigned long long abusiveSent = 0, abusiveReceived = 0;
+    Latency latency;
+    Latency crossNode;      // sender on another server
+
+    void Merge(const Stats& o) {
+        sent += o.sent;
+        received += o.received;
+        notices += o.notices;
+        garbled += o.garbled;
+        abusiveSent += o.abusiveSent;
+        abusiveReceived += o.abusiveReceived;
+        latency.Merge(o.latency);
+        crossNode.Merge(o.crossNode);
+    }
+};
+
+Stats interval, total;
+Stats phase[2];             // by send time: before / after the abusers join
+long long abuseUs = 0x7fffffffffffffffLL;
+
+Stats& Phase(long long sentUs) {
+    return phase[sentUs >= abuseUs ? 1 : 0];
+}
+
+// -------------------- Bots --------------------
+struct Bot {
+    int id;
+    int node;               // index into the server list
+    std::unique_ptr<ChatSession> session;
+    bool up = false;
+    bool synced = false;    // has seen bot 0's "sync", so the server fans out to it
+    bool abusive = false;
+    unsigned seq = 0;
+    long long nextSendUs = 0;
+    std::string in;         // partial line from the last Recv()
+};
+
+int botsUp = 0, botsFailed = 0, botsLost = 0;
+std::vector<int> botNode;   // bot id -> server index
+int nodes = 1;
+
+void OnLine(Bot& b, const std::string& line) {
+    int from;
+    unsigned seq;
+    long long sentUs;
+    if (line == "sync") {
+        b.synced = true;
+    } else if (b.abusive) {
+        // only normal bots are measured
+    } else if (line.compare(0, 3, "ab ") == 0) {
+        interval.abusiveReceived++;
+    } else if (sscanf(line.c_str(), "lt %d %u %lld", &from, &seq, &sentUs) == 3) {
+        long long us = NowUs() - sentUs;
+        interval.received++;
+        interval.latency.Add(us);
+        Phase(sentUs).received++;
+        Phase(sentUs).latency.Add(us);
+        if (from >= 0 && from < (int)botNode.size() && botNode[from] != b.node) interval.crossNode.Add(us);
+    } else if (line.compare(0, 7, "Server:") == 0) {
+        interval.notices++;
+        Phase(NowUs()).notices++;
+    } else {
+        interval.garbled++;
+    }
+}
+
+ChatTask RunBot(Bot& b, std::string host, int port) {
+    if (!co_await b.session->Connect(host.c_str(), port)) {
+        botsFailed++;
+        co_return;
+    }
+    b.up = true;
+    botsUp++;
+
+    while (true) {
+        std::string data = co_await b.session->Recv();
+        if (data.empty()) break;
+
+        // The server relays whatever one recv() gave it, so a message
+        // may arrive in pieces or several at once; lines sort it out.
+        b.in += data;
+        size_t start = 0, nl;
+        while ((nl = b.in.find('\n', start)) != std::string::npos) {
+            OnLine(b, b.in.substr(start, nl - start));
+            start = nl + 1;
+        }
+        b.in.erase(0, start);
+    }
+
+    b.up = false;
+    botsUp--;
+    botsLost++;
+}
+
+void SendDue(std::vector<std::unique_ptr<Bot>>& bots, double rate, double abuseRate, long long now) {
+    for (auto& b : bots) {
+        if (!b->up || now < b->nextSendUs) continue;
+        long long gapUs = (long long)(1e6 / (b->abusive ? abuseRate : rate));
+        char line[64];
+        snprintf(line, sizeof(line), "%s %d %u %lld\n", b->abusive ? "ab" : "lt", b->id, b->seq++, now);
+        b->session->Send(line);
+        if (b->abusive) interval.abusiveSent++;
+        else {
+            interval.sent++;
+            Phase(now).sent++;
+        }
+        b->nextSendUs += gapUs;
+        if (b->nextSendUs < now) b->nextSendUs = now + gapUs;   // fell behind: don't burst
+    }
+}
+
+void PrintInterval(int second) {
+    printf("%4d s  bots %5d  sent %8llu/s  delivered %9llu/s  p50 %7.2f ms  p99 %7.2f ms  notices %llu  garbled %llu\n",
+        second, botsUp, interval.sent, interval.received,
+        interval.latency.Percentile(0.50), interval.latency.Percentile(0.99),
+        interval.notices, interval.garbled);
+    if (nodes > 1)
+        printf("        cross-node  %9llu/s  p50 %7.2f ms  p99 %7.2f ms\n", interval.crossNode.count,
+            interval.crossNode.Percentile(0.50), interval.crossNode.Percentile(0.99));
+    if (interval.abusiveSent || interval.abusiveReceived)
+        printf("        abusive sent %8llu/s  reached normal bots %9llu/s\n",
+            interval.abusiveSent, interval.abusiveReceived);
+    total.Merge(interval);
+    interval = Stats();
+}
+
+// Deliveries against what the normal bots still connected should have seen.
+void PrintPhase(const char* name, const Stats& s, int peers) {
+    unsigned long long expected = s.sent * (unsigned long long)(peers > 1 ? peers - 1 : 0);
+    printf("  %-14s %9llu sent  %10llu delivered  %7.2f%%  p50 %7.2f ms  p99 %7.2f ms  notices %llu\n",
+        name, s.sent, s.received, expected ? 100.0 * s.received / expected : 0.0,
+        s.latency.Percentile(0.50), s.latency.Percentile(0.99), s.notices);
+}
+
+// Until every other connected bot has seen a "sync" from bot 0.
+bool WaitForSync(ChatLoop& loop, std::vector<std::unique_ptr<Bot>>& bots) {
+    long long deadline = NowUs() + SYNC_TIMEOUT_MS * 1000LL, nextSync = 0;
+    while (NowUs() < deadline) {
+        if (!bots[0]->up) return false;
+        if (NowUs() >= nextSync) {
+            bots[0]->session->Send("sync\n");
+            nextSync = NowUs() + SYNC_MS * 1000LL;
+        }
+        loop.RunOnce(TICK_MS);
+
+        bool all = true;
+        for (size_t i = 1; i < bots.size(); i++)
+            if (bots[i]->up && !bots[i]->synced) { all = false; break; }
+        if (all) return true;
+    }
+    return false;
+}
+
+// -------------------- main --------------------
+int main(int argc, char** argv) {
+    if (argc < 2 || !strchr(argv[1], ':')) {
+        printf("usage: loadtest host:port[,host:port...] [bots] [msgs/s per bot] [seconds] [-z] [-a abusers msgs/s]\n");
+        return 1;
+    }
+
+    std::vector<std::string> hosts;
+    std::vector<int> ports;
+    std::string list = argv[1];
+    for (size_t i = 0; i < list.size(); ) {
+        size_t end = list.find(',', i);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(i, end - i);
+        size_t colon = item.rfind(':');
+        if (colon != std::string::npos) {
+            hosts.push_back(item.substr(0, colon));
+            ports.push_back(atoi(item.c_str() + colon + 1));
+        }
+        i = end + 1;
+    }
+    if (hosts.empty()) return 1;
+    nodes = (int)hosts.size();
+
+    // Numbers in order, flags anywhere after the server list
+    int count = 100, seconds = 30, abusers = 0, positional = 0;
+    double rate = 1, abuseRate = 5;
+    bool compress = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-z") == 0) {
+            compress = true;
+        } else if (strcmp(argv[i], "-a") == 0 && i + 2 < argc) {
+            abusers = atoi(argv[i + 1]);
+            abuseRate = atof(argv[i + 2]);
+            i += 2;
+        } else if (positional == 0) {
+            count = atoi(argv[i]); positional++;
+        } else if (positional == 1) {
+            rate = atof(argv[i]); positional++;
+        } else if (positional == 2) {
+            seconds = atoi(argv[i]); positional++;
+        }
+    }
+    if (count < 1) count = 100;
+    if (rate <= 0) rate = 1;
+    if (seconds < 1) seconds = 30;
+    if (abusers < 0) abusers = 0;
+    if (abuseRate <= 0) abuseRate = 5;
+    if (compress && LoadChatDictionary(CHAT_DICTIONARY_FILE))
+        printf("compression dictionary %s (id %s)\n", CHAT_DICTIONARY_FILE, ChatDictionaryId().c_str());
+
+    ChatLoop loop;
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (int i = 0; i < count + abusers; i++) {
+        std::unique_ptr<Bot> b(new Bot());
+        b->id = i;
+        b->abusive = i >= count;
+        b->node = i % nodes;
+        botNode.push_back(b->node);
+        b->session.reset(new ChatSession(loop));
+        b->session->EnableCompression(compress);
+        RunBot(*b, hosts[b->node], ports[b->node]);
+        bots.push_back(std::move(b));
+    }
+
+    // Everyone is listening before the first message goes out
+    while (botsUp + botsFailed < count + abusers) loop.RunOnce(TICK_MS);
+    printf("%d bots connected, %d failed\n", botsUp, botsFailed);
+    if (!WaitForSync(loop, bots)) printf("warning: not every bot heard the sync, results will show losses\n");
+
+    // Abusers hold off until the normal bots have run for half the test
+    long long startUs = NowUs();
+    int abuseAt = abusers ? seconds / 2 : seconds + 1;
+    abuseUs = startUs + abuseAt * 1000000LL;
+    for (auto& b : bots) {
+        if (b->abusive) b->nextSendUs = abuseUs + RAMP_MS * 1000LL * (b->id - count) / abusers;
+        else b->nextSendUs = startUs + RAMP_MS * 1000LL * b->id / count;
+    }
+
+    long long endUs = NowUs() + seconds * 1000000LL;
+    long long nextReport = NowUs() + 1000000;
+    int second = 0;
+    while (true) {
+        loop.RunOnce(TICK_MS);
+        long long now = NowUs();
+        if (now < endUs) SendDue(bots, rate, abuseRate, now);
+        if (now >= nextReport) {
+            if (abusers && second == abuseAt) printf("---- %d abusive bots start at %g msgs/s ----\n", abusers, abuseRate);
+            PrintInterval(++second);
+            nextReport += 1000000;
+        }
+        if (now >= endUs + DRAIN_MS * 1000LL) break;
+    }
+    total.Merge(interval);
+
+    // Every message should reach every other normal bot still connected
+    int normalUp = 0;
+    for (auto& b : bots)
+        if (b->up && !b->abusive) normalUp++;
+    unsigned long long expected = total.sent * (unsigned long long)(normalUp > 1 ? normalUp - 1 : 0);
+    printf("\ntotal: %d bots up, %d failed to connect, %d lost\n", botsUp, botsFailed, botsLost);
+    printf("       %llu sent, %llu delivered of %llu expected (%.2f%%)\n",
+        total.sent, total.received, expected, expected ? 100.0 * total.received / expected : 0.0);
+    printf("       latency p50 %.2f ms, p99 %.2f ms; %llu notices, %llu garbled\n",
+        total.latency.Percentile(0.50), total.latency.Percentile(0.99), total.notices, total.garbled);
+    if (nodes > 1)
+        printf("       across %d nodes: %llu cross-node deliveries, p50 %.2f ms, p99 %.2f ms\n", nodes,
+            total.crossNode.count, total.crossNode.Percentile(0.50), total.crossNode.Percentile(0.99));
+    if (abusers) {
+        printf("\nnormal bots (%d up) before and after %d abusers at %g msgs/s:\n", normalUp, abusers, abuseRate);
+        PrintPhase("before", phase[0], normalUp);
+        PrintPhase("with abusers", phase[1], normalUp);
+        printf("  abusive: %llu sent, %llu reached normal bots (%.2f%%)\n", total.abusiveSent, total.abusiveReceived,
+            total.abusiveSent && normalUp ? 100.0 * total.abusiveReceived / (total.abusiveSent * normalUp) : 0.0);
+    }
+    return 0;
+}
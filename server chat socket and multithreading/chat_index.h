@@ -0,0 +1,401 @@
+#ifndef CHAT_INDEX_H
+#define CHAT_INDEX_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+/*
+========================================================
+CHAT HISTORY SEARCH INDEX
+--------------------------------------------------------
+- Incremental inverted index, one Add() per broadcast
+- Message ids are assigned in arrival order, so every
+  posting list is sorted and stored as varint deltas
+- Lists are cut into blocks of SKIP_EVERY postings with
+  a skip entry (first id, byte offset) per block, so a
+  cursor can start at the newest block and walk back
+- Search walks newest-first and stops after `limit`
+  hits, so its cost follows the results shown, not the
+  number of matches in the whole history. Phrases are
+  checked on at most MAX_PHRASE_CHECKS candidates; past
+  that the result is marked partial
+- Find() and More() walk the index and need the
+  caller's lock; Query::Check() does the phrase checks
+  on texts that are never moved or changed, so it runs
+  without it
+- Query syntax (all parts are ANDed):
+      word            message text contains word
+      "two words"     exact phrase (case-insensitive)
+      from:N          sent by client N
+      last:M          sent in the last M minutes
+- Texts live in fixed-size chunks and per-message data in
+  deques, so growing the history never copies it (Add()
+  runs under the server's lock)
+- Memory: about 75 bytes per message on indexbench's
+  corpus (text, postings, sender, time), i.e. ~375 MB
+  per 5M messages; there is no eviction here, the
+  server bounds it (HISTORY_GENERATION)
+- Not thread-safe; the server guards it with a mutex
+========================================================
+*/
+
+#define SKIP_EVERY 64
+#define ARENA_CHUNK (16 << 20)   // bytes of message text per chunk
+#define MAX_PHRASE_CHECKS 20000  // candidates a phrase query checks before it gives up
+
+class ChatIndex {
+public:
+    struct Result {
+        std::vector<uint32_t> ids;  // oldest first
+        bool partial = false;       // stopped at MAX_PHRASE_CHECKS; older matches unseen
+    };
+
+    class Query;
+
+    // Index one message and keep its text for phrase checks and results.
+    uint32_t Add(int sender, const char* text, time_t when) {
+        uint32_t id = (uint32_t)offsets.size();
+
+        // Stored with its terminator; a chunk is never reallocated
+        size_t len = strlen(text) + 1;
+        if (arena.empty() || arena.back().size() + len > ARENA_CHUNK) {
+            arena.emplace_back();
+            arena.back().reserve(std::max<size_t>(ARENA_CHUNK, len));
+        }
+        offsets.push_back((uint64_t)(arena.size() - 1) * ARENA_CHUNK + arena.back().size());
+        arena.back().append(text, len);
+
+        senders.push_back(sender);
+        times.push_back(when);
+
+        std::vector<std::string> words;
+        Tokenize(text, words);
+        for (const std::string& w : words) Post(w, id);
+        Post(SenderTerm(sender), id);
+        return id;
+    }
+
+    // The newest `limit` matches, for callers that hold their lock
+    // throughout. The server drops it for the phrase checks instead:
+    //   lock    Query q = index.Find(text, limit)
+    //           q.Check()                       (no lock: reads texts only)
+    //   lock    while (!q.Done()) index.More(q), then q.Check()
+    Result Search(const std::string& query, size_t limit) const {
+        Query q = Find(query, limit);
+        q.Check();
+        while (!q.Done()) {
+            More(q);
+            q.Check();
+        }
+        return q.Take();
+    }
+
+    // Parse and collect the first batch of candidates.
+    Query Find(const std::string& text, size_t limit) const;
+
+    // The next batch; a phrase query's batches double in size, so one
+    // whose first candidates match costs no more than before.
+    void More(Query& q) const;
+
+    size_t Count() const { return offsets.size(); }
+    int Sender(uint32_t id) const { return senders[id]; }
+    time_t Time(uint32_t id) const { return times[id]; }
+
+    std::string Text(uint32_t id) const { return TextPtr(id); }
+
+private:
+    const char* TextPtr(uint32_t id) const {
+        uint64_t off = offsets[id];
+        return arena[(size_t)(off / ARENA_CHUNK)].data() + off % ARENA_CHUNK;
+    }
+
+    struct Skip { uint32_t id; uint64_t pos; };
+
+    struct Posting {
+        std::string bytes;          // varint deltas
+        std::vector<Skip> skips;    // per block: first id, offset just past it
+        uint32_t last = 0;
+        uint32_t count = 0;
+    };
+
+    // Walks one posting list from the newest id back. Deltas only
+    // decode forwards, so it unpacks one block at a time.
+    struct Cursor {
+        const Posting* list;
+        uint32_t ids[SKIP_EVERY];
+        uint32_t n = 0, i = 0;      // ids in the loaded block, current index
+        size_t block = 0;
+        uint32_t cur = 0;
+        bool done = false;
+
+        explicit Cursor(const Posting* p) : list(p) {
+            Load(list->skips.size() - 1);
+            i = n - 1;
+            cur = ids[i];
+        }
+
+        void Load(size_t b) {
+            block = b;
+            const Skip& k = list->skips[b];
+            n = (uint32_t)std::min<uint64_t>(SKIP_EVERY, list->count - (uint64_t)b * SKIP_EVERY);
+            ids[0] = k.id;
+
+            size_t pos = (size_t)k.pos;
+            for (uint32_t j = 1; j < n; j++) {
+                uint32_t delta = 0;
+                int shift = 0;
+                unsigned char c;
+                do {
+                    c = (unsigned char)list->bytes[pos++];
+                    delta |= (uint32_t)(c & 0x7f) << shift;
+                    shift += 7;
+                } while (c & 0x80);
+                ids[j] = ids[j - 1] + delta;
+            }
+        }
+
+        void Prev() {
+            if (i) {
+                cur = ids[--i];
+            } else if (block) {
+                Load(block - 1);
+                i = n - 1;
+                cur = ids[i];
+            } else {
+                done = true;
+            }
+        }
+
+        // Move to the last posting <= target.
+        void SeekBackTo(uint32_t target) {
+            if (done || cur <= target) return;
+
+            if (ids[0] > target) {
+                // Last block starting at or below target, before this one
+                const std::vector<Skip>& s = list->skips;
+                auto it = std::upper_bound(s.begin(), s.begin() + block, target,
+                    [](uint32_t t, const Skip& k) { return t < k.id; });
+                if (it == s.begin()) { done = true; return; }
+                Load((size_t)(it - s.begin()) - 1);
+                i = n - 1;
+            }
+            i = (uint32_t)(std::upper_bound(ids, ids + i + 1, target) - ids) - 1;
+            cur = ids[i];
+        }
+    };
+
+public:
+    // One search in progress. Holds cursors into the index, so it must
+    // not outlive it; only Find() and More() touch the index.
+    class Query {
+    public:
+        // Phrase checks on the candidates More() collected. Needs no
+        // lock: texts are never moved or changed once added.
+        void Check() {
+            for (size_t i = 0; i < ids.size() && hits.size() < limit; i++)
+                if (phrases.empty() || MatchesPhrases(texts[i], phrases)) hits.push_back(ids[i]);
+            checked += ids.size();
+            ids.clear();
+            texts.clear();
+        }
+
+        bool Done() const {
+            return hits.size() >= limit || exhausted || checked >= MAX_PHRASE_CHECKS;
+        }
+
+        Result Take() {
+            Result r;
+            r.partial = !exhausted && hits.size() < limit;
+            r.ids.assign(hits.rbegin(), hits.rend());
+            return r;
+        }
+
+    private:
+        friend class ChatIndex;
+
+        std::vector<std::string> phrases;   // lower-cased
+        std::vector<Cursor> cursors;        // empty: scanning ids back from nextId
+        uint32_t minId = 0, nextId = 0;
+        size_t limit = 0, checked = 0;
+        bool exhausted = false;
+
+        std::vector<uint32_t> ids;          // this batch, newest first
+        std::vector<const char*> texts;     // their texts, for Check()
+        std::vector<uint32_t> hits;         // newest first
+    };
+
+private:
+
+    void Post(const std::string& term, uint32_t id) {
+        Posting& p = postings[term];
+        if (p.count && p.last == id) return;    // repeated word in one message
+
+        uint32_t delta = p.count ? id - p.last : id;
+        while (delta >= 0x80) {
+            p.bytes += (char)((delta & 0x7f) | 0x80);
+            delta >>= 7;
+        }
+        p.bytes += (char)delta;
+
+        if (p.count % SKIP_EVERY == 0) p.skips.push_back({ id, (uint64_t)p.bytes.size() });
+        p.last = id;
+        p.count++;
+    }
+
+    static std::string SenderTerm(int sender) {
+        return "from:" + std::to_string(sender);
+    }
+
+    static char Lower(char c) {
+        return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+    }
+
+    static bool IsWordChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || (unsigned char)c >= 0x80;
+    }
+
+    static void Tokenize(const char* text, std::vector<std::string>& out) {
+        std::string w;
+        for (const char* p = text; ; p++) {
+            if (*p && IsWordChar(*p)) {
+                w += Lower(*p);
+            } else {
+                if (!w.empty()) out.push_back(w);
+                w.clear();
+                if (!*p) break;
+            }
+        }
+    }
+
+    void ParseQuery(const std::string& q, std::vector<std::string>& terms,
+                    std::vector<std::string>& phrases, uint32_t& minId, bool& ranged) const {
+        size_t i = 0;
+        while (i < q.size()) {
+            if (q[i] == ' ') { i++; continue; }
+
+            if (q[i] == '"') {
+                size_t end = q.find('"', i + 1);
+                if (end == std::string::npos) end = q.size();
+                std::string p = q.substr(i + 1, end - i - 1);
+                if (!p.empty()) phrases.push_back(p);
+                i = end + 1;
+                continue;
+            }
+
+            size_t end = q.find(' ', i);
+            if (end == std::string::npos) end = q.size();
+            std::string word = q.substr(i, end - i);
+            i = end;
+
+            if (word.compare(0, 5, "from:") == 0) {
+                terms.push_back(SenderTerm(atoi(word.c_str() + 5)));
+            } else if (word.compare(0, 5, "last:") == 0) {
+                time_t since = time(NULL) - (time_t)atoi(word.c_str() + 5) * 60;
+                minId = (uint32_t)(std::lower_bound(times.begin(), times.end(), since) - times.begin());
+                ranged = true;
+            } else {
+                Tokenize(word.c_str(), terms);
+            }
+        }
+    }
+
+    // Case-insensitive, in place: phrases are already lower-case.
+    static bool Contains(const char* text, const std::string& phrase) {
+        for (const char* t = text; *t; t++) {
+            size_t k = 0;
+            while (k < phrase.size() && t[k] && Lower(t[k]) == phrase[k]) k++;
+            if (k == phrase.size()) return true;
+        }
+        return phrase.empty();
+    }
+
+    static bool MatchesPhrases(const char* text, const std::vector<std::string>& phrases) {
+        for (const std::string& p : phrases)
+            if (!Contains(text, p)) return false;
+        return true;
+    }
+
+    std::unordered_map<std::string, Posting> postings;
+
+    std::deque<std::string> arena;  // message texts, NUL-terminated, ARENA_CHUNK each; never moved
+    std::deque<uint64_t> offsets;   // chunk * ARENA_CHUNK + position; passes 4 GB
+    std::deque<int> senders;
+    std::deque<time_t> times;       // non-decreasing, so ranges are a binary search
+};
+
+inline ChatIndex::Query ChatIndex::Find(const std::string& text, size_t limit) const {
+    Query q;
+    std::vector<std::string> terms;
+    bool ranged = false;
+    ParseQuery(text, terms, q.phrases, q.minId, ranged);
+    q.limit = limit;
+    q.nextId = (uint32_t)Count();
+
+    // Every phrase word must also be present, so phrases only add a
+    // final substring check on the candidates the terms produce.
+    for (std::string& p : q.phrases) {
+        Tokenize(p.c_str(), terms);
+        std::transform(p.begin(), p.end(), p.begin(), Lower);
+    }
+
+    // Time range only: ids are in time order, scan back from the end
+    q.exhausted = !limit || (terms.empty() && !ranged);
+    for (const std::string& t : terms) {
+        auto it = postings.find(t);
+        if (it == postings.end()) q.exhausted = true;
+        if (q.exhausted) break;
+        q.cursors.push_back(Cursor(&it->second));
+    }
+    std::sort(q.cursors.begin(), q.cursors.end(),
+        [](const Cursor& a, const Cursor& b) { return a.list->count < b.list->count; });
+
+    More(q);
+    return q;
+}
+
+inline void ChatIndex::More(Query& q) const {
+    if (q.exhausted) return;
+    size_t want = q.limit - q.hits.size();
+    if (!q.phrases.empty())
+        want = std::min<size_t>(std::max(q.limit * 4, q.checked), MAX_PHRASE_CHECKS - q.checked);
+
+    auto take = [&](uint32_t id) {
+        q.ids.push_back(id);
+        if (!q.phrases.empty()) q.texts.push_back(TextPtr(id));
+    };
+
+    if (q.cursors.empty()) {
+        while (q.nextId > q.minId && q.ids.size() < want) take(--q.nextId);
+        q.exhausted = q.nextId <= q.minId;
+        return;
+    }
+
+    // Drive from the rarest term, newest first; skip the others back to match
+    Cursor& lead = q.cursors[0];
+    while (!lead.done && lead.cur >= q.minId && q.ids.size() < want) {
+        uint32_t id = lead.cur;
+        bool all = true;
+        for (size_t i = 1; i < q.cursors.size(); i++) {
+            q.cursors[i].SeekBackTo(id);
+            if (q.cursors[i].done) { lead.done = true; all = false; break; }
+            if (q.cursors[i].cur != id) { all = false; id = q.cursors[i].cur; break; }
+        }
+        if (all) {
+            take(id);
+            lead.Prev();
+        } else {
+            lead.SeekBackTo(id);
+        }
+    }
+    q.exhausted = lead.done || lead.cur < q.minId;
+}
+
+#endif
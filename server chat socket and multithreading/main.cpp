@@ -1,11 +1,25 @@
 #include <windows.h>
 #include <winsock2.h>
+#include <ws2tcpip.h>
 #include <vector>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
+#include <ctime>
 
 #pragma comment(lib, "ws2_32.lib")
 #include "resource.h"
+#include "../common/message_view_win32.h"
+#include "chat_index.h"
+#include "peer_link.h"
+#include "../common/chat_compress.h"
+
+#define WM_APP_LOG (WM_APP + 1)
 
 /*
 ========================================================
@@ -15,17 +29,40 @@ TCP CHAT SERVER (GUI)
 - Accepts multiple clients via threads
 - Broadcasts messages to all connected clients
 - Thread-safe client list using std::mutex
+- Every broadcast is added to a searchable history index
+- Per-client and whole-room token buckets drop floods
+  before they reach Broadcast
+- Clients that ask for it get compressed frames; each
+  broadcast is compressed once for all of them
+- Optional federation: broadcasts are relayed to peer
+  server nodes over a second port (chat port + 1000)
 - Light blue GUI with scrollable log window
 - Custom icon for taskbar/title
 ========================================================
 */
 
-HWND hPortInput, hStartBtn, hLogBox;
-SOCKET serverSocket;
+HWND hMainWnd, hPortInput, hPeersInput, hStartBtn, hSearchInput, hSearchBtn, hLogBox;
+MessageView logView;
+SOCKET serverSocket, peerSocket = INVALID_SOCKET;
 bool running = false;
 
-std::vector<SOCKET> clients;
-std::mutex clientsMtx;
+std::vector<SOCKET> clients;       // plain text
+std::vector<SOCKET> zclients;      // compressed group, share groupEncoder
+std::vector<SOCKET> zwaiting;      // compressed, but joined mid-epoch: FRAME_PLAIN until the next
+ChatEncoder groupEncoder;
+size_t epochBytes = 0;             // compressed by groupEncoder since its last Reset()
+std::mutex clientsMtx;             // guards all of the above
+std::string compressOffer;         // first bytes to every client, names the dictionary
+
+// At most two generations of HISTORY_GENERATION messages (~375 MB
+// each, see chat_index.h): when the newer fills, the older is dropped.
+// A search holds its own reference, so it can outlive the swap.
+#define HISTORY_GENERATION 5000000
+std::shared_ptr<ChatIndex> history = std::make_shared<ChatIndex>(), oldHistory;
+std::mutex historyMtx;             // guards both
+std::atomic<bool> searching(false);
+
+#define MAX_SEARCH_RESULTS 20
 
 // -------------------- Colors --------------------
 COLORREF winBgColor   = RGB(225, 240, 255); // window background
@@ -35,45 +72,923 @@ COLORREF btnTextColor = RGB(255, 255, 255); // button text
 COLORREF logBgColor   = RGB(245, 255, 255); // log box background
 
 // -------------------- Logging --------------------
+// Any thread may call Log(); lines are queued in logView and the
+// window flushes them to the EDIT control in one batch (WM_APP_LOG).
 void Log(const char* text) {
-    int len = GetWindowTextLength(hLogBox);
-    SendMessage(hLogBox, EM_SETSEL, len, len);
-    SendMessage(hLogBox, EM_REPLACESEL, 0, (LPARAM)text);
-    SendMessage(hLogBox, EM_REPLACESEL, 0, (LPARAM)"\r\n");
+    if (logView.Push(text) && hMainWnd)
+        PostMessage(hMainWnd, WM_APP_LOG, 0, 0);
+}
+
+// -------------------- Compression stats --------------------
+std::atomic<unsigned long long> statZMsgs(0), statZRaw(0), statZWire(0), statZTicks(0);
+
+long long Ticks() {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+void LogCompressionStats() {
+    unsigned long long msgs = statZMsgs.exchange(0);
+    unsigned long long raw = statZRaw.exchange(0);
+    unsigned long long wire = statZWire.exchange(0);
+    unsigned long long ticks = statZTicks.exchange(0);
+    if (!msgs || !raw) return;
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    char line[200];
+    snprintf(line, sizeof(line),
+        "Compression: %llu msgs, %.1f KB raw -> %.1f KB on wire (%.0f%%), %.2f us CPU per message",
+        msgs, raw / 1024.0, wire / 1024.0, 100.0 * wire / raw,
+        ticks * 1e6 / freq.QuadPart / msgs);
+    Log(line);
 }
 
 // -------------------- Broadcast --------------------
+// The group context only restarts from the dictionary (an empty
+// FRAME_SYNC) when a client is waiting to join and the epoch has run
+// for EPOCH_BYTES, so a join costs its peers at most one reset per
+// EPOCH_BYTES and the joiner needs no snapshot of the window.
+#define EPOCH_BYTES 16384
+
+void StartEpoch() {
+    std::string marker;
+    AppendFrame(marker, FRAME_SYNC, "");
+    for (SOCKET c : zclients) {
+        send(c, marker.data(), (int)marker.size(), 0);
+        statZWire += marker.size();
+    }
+    zclients.insert(zclients.end(), zwaiting.begin(), zwaiting.end());
+    zwaiting.clear();
+    groupEncoder.Reset();
+    epochBytes = 0;
+}
+
 void Broadcast(const char* msg, SOCKET exclude) {
+    size_t len = strlen(msg);
     std::lock_guard<std::mutex> lock(clientsMtx);
     for (SOCKET c : clients)
         if (c != exclude)
-            send(c, msg, strlen(msg), 0);
+            send(c, msg, len, 0);
+
+    if (!zwaiting.empty() && (epochBytes >= EPOCH_BYTES || zclients.empty())) StartEpoch();
+
+    if (!zwaiting.empty()) {
+        std::string frame;
+        AppendFrame(frame, FRAME_PLAIN, std::string(msg, len));
+        for (SOCKET c : zwaiting) {
+            if (c == exclude) continue;
+            send(c, frame.data(), (int)frame.size(), 0);
+            statZRaw += len;
+            statZWire += frame.size();
+        }
+    }
+
+    if (zclients.empty()) return;
+
+    // Compressed once for the whole group. The sender still gets it as
+    // an echo, or its decoder would fall out of step with the group.
+    // Plain, the sender would get nothing, so the echo is all overhead.
+    long long t0 = Ticks();
+    std::string frame;
+    AppendFrame(frame, FRAME_MSG, groupEncoder.Compress(msg, len));
+    statZTicks += Ticks() - t0;
+    statZMsgs++;
+    epochBytes += len;
+
+    for (SOCKET c : zclients) {
+        frame[0] = (char)(c == exclude ? FRAME_ECHO : FRAME_MSG);
+        send(c, frame.data(), (int)frame.size(), 0);
+        if (c != exclude) statZRaw += len;
+        statZWire += frame.size();
+    }
+}
+
+// -------------------- Rate Limiting --------------------
+// A message must get a token from its client's bucket and then from
+// the room bucket (the whole server is one room) before fan-out.
+// Tokens are per line: one recv() may carry several, and packing them
+// into one send must not make them cheaper.
+// The client bucket is owned by its thread, so the common case takes
+// no lock; the room lock is only taken for messages that pass it.
+//
+// Clients that each stay under their own limit can still fill the
+// room together. So once the room bucket is below ROOM_BUSY_LEVEL,
+// a message also needs a token from its client's share bucket, which
+// refills at an equal split of the room between recent senders: quiet
+// clients keep getting through and the heavy ones are cut back first.
+#define CLIENT_MSGS_PER_SEC    5
+#define CLIENT_BURST           10
+#define ROOM_MSGS_PER_SEC      200
+#define ROOM_BURST             400
+#define ROOM_BUSY_LEVEL        (ROOM_BURST / 2)
+#define SHARE_BURST            2
+#define SENDER_WINDOW_MS       1000 // senders are counted per window
+#define DISCONNECT_AFTER_DROPS 50   // dropped lines within DROP_WINDOW_MS before hanging up
+#define DROP_WINDOW_MS         10000
+
+#define SLOW_DOWN_MSG  "Server: you are sending too fast, messages are being dropped."
+#define ROOM_BUSY_MSG  "Server: the room is busy, some of your messages are being dropped."
+#define KICKED_MSG     "Server: rate limit exceeded, disconnecting."
+
+struct TokenBucket {
+    double tokens, rate, burst;
+    unsigned long long last;
+
+    TokenBucket(double perSec, double maxBurst)
+        : tokens(maxBurst), rate(perSec / 1000.0), burst(maxBurst), last(GetTickCount64()) {}
+
+    void Refill(unsigned long long now) {
+        tokens += (now - last) * rate;
+        if (tokens > burst) tokens = burst;
+        last = now;
+    }
+
+    bool Take(unsigned long long now, unsigned n = 1) {
+        Refill(now);
+        if (tokens < n) return false;
+        tokens -= n;
+        return true;
+    }
+
+    void Refund(unsigned n = 1) { tokens += n; }
+};
+
+// One per connection. `bucket` belongs to the client's thread;
+// `share` and `window` are only touched under roomMtx.
+struct ClientLimits {
+    TokenBucket bucket;
+    TokenBucket share;
+    unsigned long long window = ~0ULL;      // last window this client was counted in
+
+    ClientLimits() : bucket(CLIENT_MSGS_PER_SEC, CLIENT_BURST), share(CLIENT_MSGS_PER_SEC, SHARE_BURST) {}
+};
+
+TokenBucket roomBucket(ROOM_MSGS_PER_SEC, ROOM_BURST);
+std::mutex roomMtx;
+
+// Distinct senders in the current and the previous window (roomMtx)
+unsigned long long senderWindow = 0;
+unsigned sendersNow = 0, sendersBefore = 0;
+
+std::atomic<unsigned> statRejectedClient(0), statRejectedRoom(0), statKicked(0);
+
+enum Admission { ADMITTED, CLIENT_LIMITED, ROOM_LIMITED };
+
+// Caller holds roomMtx.
+unsigned RecentSenders(ClientLimits& c, unsigned long long now) {
+    unsigned long long w = now / SENDER_WINDOW_MS;
+    if (w != senderWindow) {
+        sendersBefore = w == senderWindow + 1 ? sendersNow : 0;
+        sendersNow = 0;
+        senderWindow = w;
+    }
+    if (c.window != w) {
+        c.window = w;
+        sendersNow++;
+    }
+    return sendersNow > sendersBefore ? sendersNow : sendersBefore;
+}
+
+// Lines in one recv(); a trailing partial line counts as one.
+unsigned LineCount(const char* msg, int bytes) {
+    unsigned lines = 0;
+    for (int i = 0; i < bytes; i++)
+        if (msg[i] == '\n') lines++;
+    if (bytes > 0 && msg[bytes - 1] != '\n') lines++;
+    return lines ? lines : 1;
+}
+
+Admission Admit(ClientLimits& c, unsigned lines, unsigned long long now) {
+    if (!c.bucket.Take(now, lines)) {
+        statRejectedClient += lines;
+        return CLIENT_LIMITED;
+    }
+
+    std::lock_guard<std::mutex> lock(roomMtx);
+    unsigned senders = RecentSenders(c, now);
+
+    bool admitted;
+    roomBucket.Refill(now);
+    if (roomBucket.tokens < ROOM_BUSY_LEVEL) {
+        c.share.rate = ROOM_MSGS_PER_SEC / 1000.0 / senders;
+        admitted = c.share.Take(now, lines);
+        if (admitted && !roomBucket.Take(now, lines)) {
+            c.share.Refund(lines);
+            admitted = false;
+        }
+    } else {
+        admitted = roomBucket.Take(now, lines);
+    }
+
+    if (!admitted) {
+        c.bucket.Refund(lines);     // the room is full, not this client's fault
+        statRejectedRoom += lines;
+        return ROOM_LIMITED;
+    }
+    return ADMITTED;
+}
+
+void LogRateLimitStats() {
+    unsigned client = statRejectedClient.exchange(0);
+    unsigned room = statRejectedRoom.exchange(0);
+    unsigned kicked = statKicked.exchange(0);
+    if (!client && !room && !kicked) return;
+
+    char line[160];
+    snprintf(line, sizeof(line), "Rate limit: %u dropped (client), %u dropped (room), %u disconnected",
+        client, room, kicked);
+    Log(line);
+}
+
+// -------------------- History --------------------
+// Relayed messages have no local client number.
+#define REMOTE_SENDER 0
+
+// Indexed after fan-out so search never delays delivery
+void Record(int sender, const char* msg) {
+    std::shared_ptr<ChatIndex> retired;     // freed after the lock, it's big
+    {
+        std::lock_guard<std::mutex> lock(historyMtx);
+        if (history->Count() >= HISTORY_GENERATION) {
+            retired = oldHistory;
+            oldHistory = history;
+            history = std::make_shared<ChatIndex>();
+        }
+        history->Add(sender, msg, time(NULL));
+    }
+    Log(msg);
+}
+
+// -------------------- Federation --------------------
+// Each node relays its local broadcasts to every linked peer, and
+// forwards what it receives to its other peers. (origin, seq) pairs
+// are remembered per origin so a message is delivered once and stops
+// circulating, whatever the link topology.
+//
+// Nodes may run on different hosts with unrelated clocks, so frames
+// carry their age instead of a timestamp: each node adds the time a
+// frame spent with it, and the receiver adds half the link's ping
+// round trip. Only one clock is ever read per difference.
+//
+// Relayed frames skip admission control, so only nodes holding the
+// link key (CHAT_PEER_KEY in the environment) may link. Without one,
+// the peer port listens on loopback only. See peer_link.h.
+#define PEER_PORT_OFFSET  1000
+#define PEER_KEY_ENV      "CHAT_PEER_KEY"
+#define LINK_TIMEOUT_MS   5000
+#define SEQ_RESYNC_GAP    (1u << 20)   // seqs behind the window that mean a restart
+#define PEER_RETRY_MS     2000
+#define PING_INTERVAL_MS  2000
+#define MAX_RELAY_PAYLOAD 65536
+#define MAX_PEER_BACKLOG  (4 * 1024 * 1024)
+#define STATS_TIMER_ID    1
+#define STATS_INTERVAL_MS 10000
+
+// Frames from origin 0 are link-local (node ids are odd, never 0);
+// seq says which, and the payload is the pinger's NowUs().
+#define CONTROL_ORIGIN 0
+#define CONTROL_PING   1
+#define CONTROL_PONG   2
+
+struct Peer {
+    SOCKET sock;
+    std::string out;                // frames queued for the writer
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool closed = false;
+    std::atomic<unsigned long long> rttUs{0};   // last ping round trip, 0 = none yet
+};
+
+unsigned long long NowUs() {
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (unsigned long long)(t.QuadPart / f.QuadPart * 1000000 +
+                                t.QuadPart % f.QuadPart * 1000000 / f.QuadPart);
+}
+
+struct SeqWindow {
+    unsigned high = 0;              // highest seq seen
+    unsigned long long seen = 0;    // bit i: seq (high - i) seen
+    unsigned long long highUs = 0;  // NowUs() when high last moved
+};
+
+unsigned nodeId;
+LinkKey linkKey;
+bool linkKeySet = false;
+std::atomic<unsigned> localSeq(0);
+
+std::vector<std::shared_ptr<Peer>> peers;
+std::mutex peersMtx;
+
+std::unordered_map<unsigned, SeqWindow> seenSeqs;
+std::mutex seenMtx;
+
+// Counters for the periodic stats line, reset each interval
+std::atomic<unsigned> statRelayedIn(0), statFramesOut(0), statBatchesOut(0), statDropped(0), statSeqRefused(0);
+std::atomic<unsigned long long> statAgeUs(0);
+
+bool FirstTime(unsigned origin, unsigned seq) {
+    if (origin == nodeId) return false;     // our own message came back around
+
+    std::lock_guard<std::mutex> lock(seenMtx);
+    unsigned long long now = NowUs();
+    SeqWindow& w = seenSeqs[origin];
+    if (seq > w.high) {
+        // An origin can't broadcast faster than its room bucket, so a
+        // jump past that (twice over, for slack) is refused: it would
+        // push the window past every real frame still to come.
+        unsigned shift = seq - w.high;
+        unsigned long long possible = ROOM_BURST + (now - w.highUs) / 1000 * ROOM_MSGS_PER_SEC / 1000;
+        if (w.highUs && shift > 2 * possible) {
+            statSeqRefused++;
+            return false;
+        }
+        w.seen = shift >= 64 ? 0 : w.seen << shift;
+        w.seen |= 1;
+        w.high = seq;
+        w.highUs = now;
+        return true;
+    }
+
+    // Far behind can't be a late duplicate: the window was taken by a
+    // bogus first frame, or the origin restarted after a long run.
+    unsigned back = w.high - seq;
+    if (back > SEQ_RESYNC_GAP) {
+        w.seen = 1;
+        w.high = seq;
+        w.highUs = now;
+        return true;
+    }
+    if (back >= 64 || ((w.seen >> back) & 1)) return false;
+    w.seen |= 1ULL << back;
+    return true;
+}
+
+// Queue a frame for every peer except the one it came from.
+void Relay(const RelayHeader& h, const char* payload, const Peer* from) {
+    std::string frame;
+    AppendRelayHeader(frame, h);
+    frame.append(payload, h.len);
+
+    std::lock_guard<std::mutex> lock(peersMtx);
+    for (auto& p : peers) {
+        if (p.get() == from) continue;
+        std::lock_guard<std::mutex> plock(p->mtx);
+        if (p->out.size() > MAX_PEER_BACKLOG) { statDropped++; continue; }
+        p->out += frame;
+        p->cv.notify_one();
+    }
+}
+
+bool SendAll(SOCKET s, const char* data, size_t len) {
+    while (len) {
+        int n = send(s, data, (int)len, 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool RecvAll(SOCKET s, char* data, size_t len) {
+    while (len) {
+        int n = recv(s, data, (int)len, 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+std::string ControlFrame(unsigned kind, unsigned long long value) {
+    RelayHeader h = { CONTROL_ORIGIN, kind, 8, 0 };
+    std::string frame;
+    AppendRelayHeader(frame, h);
+    PutU64(frame, value);
+    return frame;
+}
+
+// Both ends prove they hold the link key before any frame is read.
+bool PeerHandshake(SOCKET s, bool outgoing) {
+    DWORD timeout = LINK_TIMEOUT_MS;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    uint64_t mine = LinkNonce(), theirs;
+    std::string hello = LinkHello(mine);
+    char in[LINK_HELLO_BYTES];
+    if (!SendAll(s, hello.data(), hello.size()) || !RecvAll(s, in, sizeof(in)) ||
+        !ParseLinkHello(in, theirs))
+        return false;
+
+    char myRole = outgoing ? LINK_ROLE_CONNECT : LINK_ROLE_ACCEPT;
+    char theirRole = outgoing ? LINK_ROLE_ACCEPT : LINK_ROLE_CONNECT;
+    std::string proof;
+    PutU64(proof, LinkProof(linkKey, myRole, mine, theirs));
+    char got[LINK_PROOF_BYTES];
+    if (!SendAll(s, proof.data(), proof.size()) || !RecvAll(s, got, sizeof(got)))
+        return false;
+    if (GetU64(got) != LinkProof(linkKey, theirRole, theirs, mine)) return false;
+
+    timeout = 0;    // links are quiet between pings
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    return true;
+}
+
+// Everything queued while the previous send was in flight goes out
+// in one send(), so a busy link batches frames by itself.
+void PeerWriter(std::shared_ptr<Peer> p) {
+    std::string batch;
+    unsigned long long nextPing = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(p->mtx);
+            p->cv.wait_for(lock, std::chrono::milliseconds(PING_INTERVAL_MS),
+                [&] { return p->closed || !p->out.empty(); });
+            if (p->closed) return;
+            if (NowUs() >= nextPing) {
+                p->out += ControlFrame(CONTROL_PING, NowUs());
+                nextPing = NowUs() + PING_INTERVAL_MS * 1000ULL;
+            }
+            batch.swap(p->out);
+        }
+        if (batch.empty()) continue;
+
+        // Turn local origin times into ages as the frames leave
+        unsigned frames = 0;
+        unsigned long long now = NowUs();
+        for (size_t pos = 0; pos < batch.size(); ) {
+            RelayHeader h = ReadRelayHeader(batch.data() + pos);
+            if (h.origin != CONTROL_ORIGIN) {
+                SetRelayStamp(&batch[pos], now > h.stampUs ? now - h.stampUs : 0);
+                frames++;
+            }
+            pos += RELAY_HEADER_BYTES + h.len;
+        }
+
+        if (!SendAll(p->sock, batch.data(), batch.size())) {
+            shutdown(p->sock, SD_BOTH);     // wakes the reader, which cleans up
+            return;
+        }
+        statFramesOut += frames;
+        if (frames) statBatchesOut++;
+        batch.clear();
+    }
+}
+
+void DeliverRemote(const RelayHeader& h, const std::string& msg, const Peer* from) {
+    Broadcast(msg.c_str(), INVALID_SOCKET);
+    Relay(h, msg.data(), from);
+
+    statRelayedIn++;
+    statAgeUs += NowUs() - h.stampUs;
+    Record(REMOTE_SENDER, msg.c_str());
+}
+
+// Pings are answered by the writer; a pong gives the link's round trip.
+void HandleControl(Peer& p, const RelayHeader& h, const std::string& payload) {
+    unsigned long long value = GetU64(payload.data());
+    if (h.seq == CONTROL_PING) {
+        std::lock_guard<std::mutex> lock(p.mtx);
+        p.out += ControlFrame(CONTROL_PONG, value);
+        p.cv.notify_one();
+    } else if (h.seq == CONTROL_PONG) {
+        p.rttUs = NowUs() - value;
+    }
+}
+
+// Reads frames from one peer link until it drops. Owns the socket.
+void RunPeerLink(SOCKET sock) {
+    auto p = std::make_shared<Peer>();
+    p->sock = sock;
+    {
+        std::lock_guard<std::mutex> lock(peersMtx);
+        peers.push_back(p);
+    }
+    std::thread writer(PeerWriter, p);
+
+    std::string in;
+    char buffer[4096];
+    bool bad = false;
+    while (!bad) {
+        size_t used = 0;
+        while (in.size() - used >= RELAY_HEADER_BYTES) {
+            RelayHeader h = ReadRelayHeader(in.data() + used);
+            if (h.len > MAX_RELAY_PAYLOAD) { bad = true; break; }
+            if (h.origin == CONTROL_ORIGIN && h.len != 8) { bad = true; break; }
+            if (in.size() - used - RELAY_HEADER_BYTES < h.len) break;
+
+            std::string msg = in.substr(used + RELAY_HEADER_BYTES, h.len);
+            used += RELAY_HEADER_BYTES + h.len;
+            if (h.origin == CONTROL_ORIGIN) {
+                HandleControl(*p, h, msg);
+                continue;
+            }
+
+            // Age on arrival, back to an origin time on our clock
+            h.stampUs = NowUs() - h.stampUs - p->rttUs / 2;
+            if (FirstTime(h.origin, h.seq)) DeliverRemote(h, msg, p.get());
+        }
+        in.erase(0, used);
+        if (bad) break;
+
+        int bytes = recv(sock, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) break;
+        in.append(buffer, bytes);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(peersMtx);
+        for (size_t i = 0; i < peers.size(); i++)
+            if (peers[i] == p) { peers.erase(peers.begin() + i); break; }
+    }
+    {
+        std::lock_guard<std::mutex> lock(p->mtx);
+        p->closed = true;
+        p->cv.notify_one();
+    }
+    writer.join();
+    closesocket(sock);
+}
+
+// Outgoing link to one configured peer; reconnects while the server runs.
+void PeerConnectThread(std::string host, int port) {
+    std::string name = host + ":" + std::to_string(port);
+    while (running) {
+        SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port + PEER_PORT_OFFSET);
+        inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+        if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            closesocket(s);
+        } else if (!PeerHandshake(s, true)) {
+            Log(("Peer " + name + " refused the link: is " PEER_KEY_ENV " the same on both?").c_str());
+            closesocket(s);
+        } else {
+            Log(("Linked to peer " + name + ".").c_str());
+            RunPeerLink(s);
+            Log(("Lost peer " + name + ".").c_str());
+        }
+        Sleep(PEER_RETRY_MS);
+    }
+}
+
+void AcceptPeer(SOCKET s) {
+    if (!PeerHandshake(s, false)) {
+        Log("Refused a peer link without the right " PEER_KEY_ENV ".");
+        closesocket(s);
+        return;
+    }
+    Log("Peer node linked.");
+    RunPeerLink(s);
+}
+
+// Incoming links from peers that list this node.
+void PeerAcceptThread() {
+    while (running) {
+        SOCKET s = accept(peerSocket, NULL, NULL);
+        if (s != INVALID_SOCKET) std::thread(AcceptPeer, s).detach();
+    }
+}
+
+// "host:port, host:port" from the Peers box.
+void StartPeerLinks(const char* list) {
+    std::string all = list;
+    size_t i = 0;
+    while (i < all.size()) {
+        size_t end = all.find(',', i);
+        if (end == std::string::npos) end = all.size();
+        std::string item = all.substr(i, end - i);
+        i = end + 1;
+
+        size_t a = item.find_first_not_of(' ');
+        size_t colon = item.rfind(':');
+        if (a == std::string::npos || colon == std::string::npos || colon < a) continue;
+        std::thread(PeerConnectThread, item.substr(a, colon - a), atoi(item.c_str() + colon + 1)).detach();
+    }
+}
+
+void LogFederationStats() {
+    unsigned in = statRelayedIn.exchange(0);
+    unsigned frames = statFramesOut.exchange(0);
+    unsigned batches = statBatchesOut.exchange(0);
+    unsigned dropped = statDropped.exchange(0);
+    unsigned refused = statSeqRefused.exchange(0);
+    unsigned long long age = statAgeUs.exchange(0);
+    if (!in && !frames && !dropped && !refused) return;
+
+    unsigned long long rtt = 0;
+    unsigned links = 0;
+    {
+        std::lock_guard<std::mutex> lock(peersMtx);
+        for (auto& p : peers)
+            if (p->rttUs) { rtt += p->rttUs; links++; }
+    }
+
+    char line[240];
+    snprintf(line, sizeof(line),
+        "Federation: %.1f msg/s in (avg %.2f ms since origin broadcast), %.1f frames/s out in %u batches, "
+        "%u dropped, %u refused (seq jump), link RTT %.2f ms",
+        in * 1000.0 / STATS_INTERVAL_MS, in ? age / 1000.0 / in : 0.0,
+        frames * 1000.0 / STATS_INTERVAL_MS, batches, dropped, refused, links ? rtt / 1000.0 / links : 0.0);
+    Log(line);
+}
+
+// -------------------- History Search --------------------
+// Runs on its own thread. historyMtx is held while the postings are
+// walked and the hits read back, not while phrase candidates are
+// checked against their texts, so Record() never waits on that.
+void SearchThread(std::string query) {
+    std::shared_ptr<ChatIndex> gens[2];
+    {
+        std::lock_guard<std::mutex> lock(historyMtx);
+        gens[0] = history;
+        gens[1] = oldHistory;
+    }
+
+    std::vector<std::string> lines;     // newest first
+    bool partial = false;
+    for (std::shared_ptr<ChatIndex>& idx : gens) {
+        if (!idx || partial || lines.size() >= MAX_SEARCH_RESULTS) break;
+
+        std::unique_lock<std::mutex> lock(historyMtx);
+        ChatIndex::Query q = idx->Find(query, MAX_SEARCH_RESULTS - lines.size());
+        lock.unlock();
+        q.Check();
+        while (!q.Done()) {
+            lock.lock();
+            idx->More(q);
+            lock.unlock();
+            q.Check();
+        }
+        ChatIndex::Result r = q.Take();
+        partial = r.partial;
+
+        lock.lock();
+        for (size_t i = r.ids.size(); i-- > 0; ) {
+            uint32_t id = r.ids[i];
+            char stamp[16];
+            time_t t = idx->Time(id);
+            strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&t));
+            lines.push_back(std::string("  [") + stamp + "] client " +
+                std::to_string(idx->Sender(id)) + ": " + idx->Text(id));
+        }
+    }
+    std::reverse(lines.begin(), lines.end());
+
+    std::string summary = std::string("Search \"") + query + "\": " + std::to_string(lines.size());
+    if (partial)
+        summary += " matches (gave up after " + std::to_string(MAX_PHRASE_CHECKS) +
+                   " phrase candidates; older messages not searched)";
+    else
+        summary += lines.size() == MAX_SEARCH_RESULTS ? "+ matches (newest shown)" : " matches";
+    Log(summary.c_str());
+    for (const std::string& line : lines) Log(line.c_str());
+    searching = false;
+}
+
+// UI thread: hands the query to SearchThread, one search at a time.
+void SearchHistory() {
+    char query[256];
+    GetWindowText(hSearchInput, query, sizeof(query));
+    if (!strlen(query)) return;
+
+    if (searching.exchange(true)) {
+        Log("A search is still running.");
+        return;
+    }
+    std::thread(SearchThread, std::string(query)).detach();
 }
 
 // -------------------- Client Thread --------------------
-void ClientThread(SOCKET client) {
-    char buffer[512];
-    Log("Client connected.");
+// Every client starts plain and is sent COMPRESS_OFFER before anything
+// else. One whose first bytes are COMPRESS_HELLO moves to the
+// compressed group, however late they arrive; clients only send it
+// after seeing the offer, so they know this server will answer.
+#define MAX_MESSAGE_LEN 511     // one recv() of a plain client, and the cap on decoded ones
+
+struct ClientState {
+    SOCKET sock;
+    int id;
+    bool compressed = false;
+    ClientLimits limits;
+    unsigned long long dropWindow = 0;  // start of the current DROP_WINDOW_MS
+    unsigned dropsInWindow = 0;         // lines over the client limit in it
+    int roomDropsInRow = 0;
+    unsigned droppedClient = 0, droppedRoom = 0;    // whole connection, for the disconnect line
+    ChatDecoder decoder;            // this client's own upstream context
+
+    ClientState(SOCKET s, int n) : sock(s), id(n) {}
+};
+
+// A message for this client only, outside any compression context.
+void SendNotice(ClientState& cs, const char* text) {
+    if (!cs.compressed) {
+        send(cs.sock, text, strlen(text), 0);
+        return;
+    }
+    std::string frame;
+    AppendFrame(frame, FRAME_PLAIN, text);
+    send(cs.sock, frame.data(), (int)frame.size(), 0);
+    statZRaw += strlen(text);
+    statZWire += frame.size();
+}
+
+void JoinClients(ClientState& cs) {
+    std::lock_guard<std::mutex> lock(clientsMtx);
+    clients.push_back(cs.sock);
+}
 
+void RemoveSocket(std::vector<SOCKET>& list, SOCKET s) {
+    for (size_t i = 0; i < list.size(); i++)
+        if (list[i] == s) { list.erase(list.begin() + i); return; }
+}
+
+// Plain -> compressed. Under the lock, so no broadcast slips between
+// the ACK and the join; earlier ones went out plain, ahead of the ACK,
+// which is where the client expects them. The client's decoder starts
+// at the dictionary: it joins the group now if that's where the group
+// is, else waits for the next epoch (see StartEpoch).
+void UpgradeClient(ClientState& cs) {
+    std::lock_guard<std::mutex> lock(clientsMtx);
+    RemoveSocket(clients, cs.sock);
+
+    send(cs.sock, COMPRESS_ACK, COMPRESS_ACK_LEN, 0);
+    if (zclients.empty()) {
+        groupEncoder.Reset();
+        epochBytes = 0;
+    }
+    if (epochBytes == 0) zclients.push_back(cs.sock);
+    else zwaiting.push_back(cs.sock);
+    cs.compressed = true;
+
+    // The handshake only costs: nothing of it would be sent plain
+    statZWire += COMPRESS_OFFER_LEN + COMPRESS_HELLO_LEN + COMPRESS_ACK_LEN;
+}
+
+void LeaveClients(ClientState& cs) {
+    std::lock_guard<std::mutex> lock(clientsMtx);
+    if (!cs.compressed) {
+        RemoveSocket(clients, cs.sock);
+        return;
+    }
+    RemoveSocket(zclients, cs.sock);
+    RemoveSocket(zwaiting, cs.sock);
+}
+
+// Returns false when the client has to be disconnected.
+bool HandleMessage(ClientState& cs, const char* msg, int bytes) {
+    if (!*msg) return true;     // Broadcast would send nothing (e.g. a late COMPRESS_HELLO)
+
+    unsigned long long now = GetTickCount64();
+    unsigned lines = LineCount(msg, (int)strlen(msg));
+    Admission a = Admit(cs.limits, lines, now);
+    if (a == ROOM_LIMITED) {
+        cs.droppedRoom += lines;
+        if (cs.roomDropsInRow++ == 0) SendNotice(cs, ROOM_BUSY_MSG);
+        return true;
+    }
+    if (a == CLIENT_LIMITED) {
+        // Counted over a window, not in a row: a token refills every
+        // 200 ms, so a flood always gets the odd line through.
+        if (now - cs.dropWindow >= DROP_WINDOW_MS) {
+            cs.dropWindow = now;
+            cs.dropsInWindow = 0;
+        }
+        cs.droppedClient += lines;
+        if (cs.dropsInWindow == 0) SendNotice(cs, SLOW_DOWN_MSG);
+        cs.dropsInWindow += lines;
+        if (cs.dropsInWindow >= DISCONNECT_AFTER_DROPS) {
+            SendNotice(cs, KICKED_MSG);
+            statKicked++;
+            Log("Client disconnected for flooding.");
+            return false;
+        }
+        return true;
+    }
+    cs.roomDropsInRow = 0;
+
+    Broadcast(msg, cs.sock);
+
+    RelayHeader h = { nodeId, ++localSeq, (unsigned)bytes, NowUs() };
+    Relay(h, msg, nullptr);
+
+    Record(cs.id, msg);
+    return true;
+}
+
+// Consume every complete frame in `in`. Messages decode to at most
+// MAX_MESSAGE_LEN, what a plain client can send, so relays and the
+// index never see more than before.
+bool HandleFrames(ClientState& cs, std::string& in) {
+    size_t pos = 0;
+    int flag;
+    std::string payload;
     while (true) {
+        size_t start = pos;
+        int r = ParseFrame(in, pos, flag, payload);
+        if (r < 0) return false;
+        if (r == 0) break;
+        if (flag != FRAME_MSG) continue;
+
+        std::string text;
+        if (!cs.decoder.Decompress(payload, text, MAX_MESSAGE_LEN)) {
+            Log(("Client " + std::to_string(cs.id) + " sent a corrupt or oversized message, disconnecting.").c_str());
+            return false;
+        }
+        statZRaw += text.size();
+        statZWire += pos - start;
+        if (!HandleMessage(cs, text.c_str(), (int)text.size())) return false;
+    }
+    in.erase(0, pos);
+    return true;
+}
+
+void ClientThread(SOCKET client, int id) {
+    ClientState cs(client, id);
+    char buffer[MAX_MESSAGE_LEN + 1];
+    std::string in;     // compressed clients: bytes not yet framed
+    bool first = true;
+
+    // Ahead of JoinClients, so no broadcast can get in front of it
+    send(client, compressOffer.data(), (int)compressOffer.size(), 0);
+    JoinClients(cs);
+    Log("Client connected.");
+
+    bool ok = true;
+    while (ok) {
         int bytes = recv(client, buffer, sizeof(buffer)-1, 0);
         if (bytes <= 0) break;
-        buffer[bytes] = 0;
-        Broadcast(buffer, client);
-        Log(buffer);
+
+        if (first) {
+            // The first bytes decide, even if the HELLO came in pieces
+            in.append(buffer, bytes);
+            if (in.size() < COMPRESS_HELLO_LEN && memcmp(in.data(), COMPRESS_HELLO, in.size()) == 0) continue;
+            first = false;
+
+            if (in.compare(0, COMPRESS_HELLO_LEN, COMPRESS_HELLO, COMPRESS_HELLO_LEN) == 0) {
+                UpgradeClient(cs);
+                Log(("Client " + std::to_string(cs.id) + " switched to compression.").c_str());
+                in.erase(0, COMPRESS_HELLO_LEN);
+                ok = HandleFrames(cs, in);
+                continue;
+            }
+            in.clear();
+        }
+
+        if (cs.compressed) {
+            in.append(buffer, bytes);
+            ok = HandleFrames(cs, in);
+        } else {
+            buffer[bytes] = 0;
+            ok = HandleMessage(cs, buffer, bytes);
+        }
     }
 
+    LeaveClients(cs);
     closesocket(client);
-    Log("Client disconnected.");
+
+    char line[160];
+    if (cs.droppedClient || cs.droppedRoom)
+        snprintf(line, sizeof(line), "Client %d disconnected (%u dropped over its limit, %u while the room was busy).",
+            cs.id, cs.droppedClient, cs.droppedRoom);
+    else
+        snprintf(line, sizeof(line), "Client disconnected.");
+    Log(line);
+}
+
+// -------------------- Listening sockets --------------------
+// INVALID_SOCKET if the port can't be had (usually: already in use).
+SOCKET Listen(int port, unsigned long ip = INADDR_ANY) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) return s;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(ip);
+
+    if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
 }
 
 // -------------------- Server Accept Thread --------------------
 void ServerThread() {
+    int nextClientId = 0;
     while (running) {
         SOCKET client = accept(serverSocket, NULL, NULL);
         if (client != INVALID_SOCKET) {
-            clients.push_back(client);
-            std::thread(ClientThread, client).detach();
+            std::thread(ClientThread, client, ++nextClientId).detach();
         }
     }
 }
@@ -94,46 +1009,118 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
 
     case WM_CREATE:
+        hMainWnd = hwnd;
+
+        // Static labels
+        CreateWindow("STATIC", "Port", WS_CHILD | WS_VISIBLE, 50, 2, 70, 16, hwnd, NULL, NULL, NULL);
+        CreateWindow("STATIC", "Peers (host:port, ...)", WS_CHILD | WS_VISIBLE, 130, 2, 190, 16, hwnd, NULL, NULL, NULL);
+
         // Port input
         hPortInput = CreateWindow("EDIT", "8080",
             WS_CHILD | WS_VISIBLE | WS_BORDER,
-            50, 20, 100, 25, hwnd, NULL, NULL, NULL);
+            50, 20, 70, 25, hwnd, NULL, NULL, NULL);
+
+        // Peer servers to relay broadcasts to (optional)
+        hPeersInput = CreateWindow("EDIT", "",
+            WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL,
+            130, 20, 190, 25, hwnd, NULL, NULL, NULL);
 
         // Start server button
         hStartBtn = CreateWindow("BUTTON", "Start Server",
             WS_CHILD | WS_VISIBLE | BS_OWNERDRAW,
-            180, 20, 150, 25, hwnd, (HMENU)1, NULL, NULL);
+            330, 20, 120, 25, hwnd, (HMENU)1, NULL, NULL);
+
+        // History search: query input + button
+        hSearchInput = CreateWindow("EDIT", "",
+            WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL,
+            50, 60, 280, 25, hwnd, NULL, NULL, NULL);
+
+        hSearchBtn = CreateWindow("BUTTON", "Search",
+            WS_CHILD | WS_VISIBLE | BS_OWNERDRAW,
+            340, 60, 110, 25, hwnd, (HMENU)2, NULL, NULL);
 
         // Scrollable log box
         hLogBox = CreateWindow("EDIT", "",
             WS_CHILD | WS_VISIBLE | WS_BORDER | ES_MULTILINE | ES_READONLY | WS_VSCROLL,
-            50, 70, 400, 360, hwnd, NULL, NULL, NULL);
+            50, 100, 400, 330, hwnd, NULL, NULL, NULL);
+
+        // Size is bounded by logView, not by the default 32K EDIT limit
+        SendMessage(hLogBox, EM_SETLIMITTEXT, 0, 0);
+        PostMessage(hwnd, WM_APP_LOG, 0, 0);
         break;
 
     case WM_COMMAND:
         if (LOWORD(wParam) == 1 && !running) {
+            char portStr[16], peerList[512];
+            GetWindowText(hPortInput, portStr, sizeof(portStr));
+            GetWindowText(hPeersInput, peerList, sizeof(peerList));
+            int port = atoi(portStr);
+            if (port <= 0 || port + PEER_PORT_OFFSET > 65535) {
+                Log("Invalid port.");
+                break;
+            }
+
             WSADATA wsa;
             WSAStartup(MAKEWORD(2,2), &wsa);
 
-            serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+            serverSocket = Listen(port);
+            if (serverSocket == INVALID_SOCKET) {
+                Log(("Cannot listen on port " + std::to_string(port) + ", is it in use?").c_str());
+                WSACleanup();
+                break;
+            }
 
-            sockaddr_in addr{};
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(8080);
-            addr.sin_addr.s_addr = INADDR_ANY;
+            // Second listener for server-to-server links. It clashes with a
+            // node whose chat port is this one + PEER_PORT_OFFSET.
+            const char* key = getenv(PEER_KEY_ENV);
+            linkKeySet = key && *key;
+            linkKey = DeriveLinkKey(linkKeySet ? key : "");
+            peerSocket = Listen(port + PEER_PORT_OFFSET, linkKeySet ? INADDR_ANY : INADDR_LOOPBACK);
+            if (peerSocket == INVALID_SOCKET) {
+                Log(("Cannot listen on peer port " + std::to_string(port + PEER_PORT_OFFSET) +
+                     " (chat port + " + std::to_string(PEER_PORT_OFFSET) + "), is it in use?").c_str());
+                closesocket(serverSocket);
+                WSACleanup();
+                break;
+            }
 
-            bind(serverSocket, (sockaddr*)&addr, sizeof(addr));
-            listen(serverSocket, SOMAXCONN);
+            nodeId = (GetTickCount() ^ (GetCurrentProcessId() << 16)) | 1;
+
+            // Clients only compress if their dictionary is the same
+            if (LoadChatDictionary(CHAT_DICTIONARY_FILE))
+                Log(("Loaded compression dictionary " CHAT_DICTIONARY_FILE " (id " + ChatDictionaryId() + ").").c_str());
+            groupEncoder.Reset();
+            compressOffer = CompressOffer();
 
             running = true;
             std::thread(ServerThread).detach();
+            std::thread(PeerAcceptThread).detach();
+            StartPeerLinks(peerList);
+            SetTimer(hwnd, STATS_TIMER_ID, STATS_INTERVAL_MS, NULL);
             Log("Server started.");
+            if (!linkKeySet)
+                Log("No " PEER_KEY_ENV " set: peer links are limited to this machine.");
         }
+
+        if (LOWORD(wParam) == 2) SearchHistory();
         break;
 
+    case WM_APP_LOG:
+        FlushToEdit(logView, hLogBox);
+        return 0;
+
+    case WM_TIMER:
+        if (wParam == STATS_TIMER_ID) {
+            LogFederationStats();
+            LogRateLimitStats();
+            LogCompressionStats();
+        }
+        return 0;
+
     case WM_DRAWITEM: {
         LPDRAWITEMSTRUCT d = (LPDRAWITEMSTRUCT)lParam;
         if (d->CtlID == 1) DrawButton(d->hDC, d->rcItem, "Start Server");
+        if (d->CtlID == 2) DrawButton(d->hDC, d->rcItem, "Search");
         break;
     }
 
@@ -159,6 +1146,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_DESTROY:
         running = false;
         closesocket(serverSocket);
+        closesocket(peerSocket);
         WSACleanup();
         PostQuitMessage(0);
         break;
@@ -167,7 +1155,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 }
 
 // -------------------- WinMain --------------------
-int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow) {
+int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR cmdLine, int nCmdShow) {
     WNDCLASS wc{};
     wc.lpfnWndProc = WndProc;
     wc.hInstance = hInst;
@@ -185,6 +1173,16 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow) {
 
     ShowWindow(hwnd, nCmdShow);
 
+    // "gui2.exe PORT [PEERS]" fills the boxes and starts right away, so
+    // scripts can bring up several nodes (see load test/federation.bat)
+    if (cmdLine && *cmdLine) {
+        std::string args = cmdLine;
+        size_t space = args.find(' ');
+        SetWindowText(hPortInput, args.substr(0, space).c_str());
+        if (space != std::string::npos) SetWindowText(hPeersInput, args.substr(space + 1).c_str());
+        PostMessage(hwnd, WM_COMMAND, MAKEWPARAM(1, BN_CLICKED), 0);
+    }
+
     MSG msg;
     while (GetMessage(&msg, NULL, 0, 0)) {
         TranslateMessage(&msg);
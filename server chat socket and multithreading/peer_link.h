@@ -0,0 +1,174 @@
+#ifndef PEER_LINK_H
+#define PEER_LINK_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <random>
+#include <atomic>
+
+/*
+========================================================
+SERVER-TO-SERVER LINK FORMAT (federation)
+--------------------------------------------------------
+- Handshake, before any frame: each side sends
+      LINK_MAGIC, 8-byte random nonce
+  then proves it holds the shared link key:
+      SipHash-2-4(key, role, own nonce, other nonce)
+  The role byte differs for the connecting and the
+  accepting side, so a proof can't be reflected back on
+  a second connection. No key set = empty key (the peer
+  port is then loopback-only, see the server)
+- Frames: RELAY_HEADER_BYTES of fixed little-endian
+  fields, then `len` payload bytes
+      u32 origin  u32 seq  u32 len  u64 stampUs
+  written field by field, so no struct padding or
+  host byte order reaches the wire
+- No Win32 code: builds and tests anywhere
+========================================================
+*/
+
+#define LINK_MAGIC         "CHATLNK1"
+#define LINK_MAGIC_BYTES   8
+#define LINK_HELLO_BYTES   (LINK_MAGIC_BYTES + 8)
+#define LINK_PROOF_BYTES   8
+#define LINK_ROLE_CONNECT  'C'
+#define LINK_ROLE_ACCEPT   'A'
+#define RELAY_HEADER_BYTES 20
+
+struct RelayHeader {
+    unsigned origin;                // node that first broadcast it
+    unsigned seq;                   // per-origin sequence number
+    unsigned len;                   // payload bytes that follow
+    unsigned long long stampUs;     // on the wire: age in us when it left the sender;
+                                    // inside a node: origin time on the local NowUs() clock
+};
+
+// -------------------- Little-endian fields --------------------
+inline void PutU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out += (char)(v >> (8 * i));
+}
+
+inline void PutU64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out += (char)(v >> (8 * i));
+}
+
+inline uint32_t GetU32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= (uint32_t)(unsigned char)p[i] << (8 * i);
+    return v;
+}
+
+inline uint64_t GetU64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)(unsigned char)p[i] << (8 * i);
+    return v;
+}
+
+inline void SetU64(char* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (char)(v >> (8 * i));
+}
+
+// -------------------- Relay header --------------------
+inline void AppendRelayHeader(std::string& out, const RelayHeader& h) {
+    PutU32(out, h.origin);
+    PutU32(out, h.seq);
+    PutU32(out, h.len);
+    PutU64(out, h.stampUs);
+}
+
+inline RelayHeader ReadRelayHeader(const char* p) {
+    RelayHeader h;
+    h.origin = GetU32(p);
+    h.seq = GetU32(p + 4);
+    h.len = GetU32(p + 8);
+    h.stampUs = GetU64(p + 12);
+    return h;
+}
+
+// Rewrites the stamp of an encoded header in place.
+inline void SetRelayStamp(char* header, uint64_t stampUs) {
+    SetU64(header + 12, stampUs);
+}
+
+// -------------------- SipHash-2-4 --------------------
+#define SIP_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+inline void SipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+    v0 += v1; v1 = SIP_ROTL(v1, 13); v1 ^= v0; v0 = SIP_ROTL(v0, 32);
+    v2 += v3; v3 = SIP_ROTL(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = SIP_ROTL(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = SIP_ROTL(v1, 17); v1 ^= v2; v2 = SIP_ROTL(v2, 32);
+}
+
+inline uint64_t SipHash24(uint64_t k0, uint64_t k1, const std::string& m) {
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL, v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL, v3 = k1 ^ 0x7465646279746573ULL;
+
+    size_t full = m.size() / 8 * 8;
+    for (size_t i = 0; i < full; i += 8) {
+        uint64_t w = GetU64(m.data() + i);
+        v3 ^= w;
+        SipRound(v0, v1, v2, v3);
+        SipRound(v0, v1, v2, v3);
+        v0 ^= w;
+    }
+
+    uint64_t last = (uint64_t)m.size() << 56;
+    for (size_t i = full; i < m.size(); i++) last |= (uint64_t)(unsigned char)m[i] << (8 * (i - full));
+    v3 ^= last;
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) SipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// -------------------- Handshake --------------------
+struct LinkKey {
+    uint64_t k0 = 0, k1 = 0;
+};
+
+// The configured key string, spread over SipHash's 128-bit key.
+inline LinkKey DeriveLinkKey(const std::string& secret) {
+    LinkKey k;
+    k.k0 = SipHash24(0x6c696e6b2d6b6579ULL, 1, secret);
+    k.k1 = SipHash24(0x6c696e6b2d6b6579ULL, 2, secret);
+    return k;
+}
+
+// Unique per call and hard to guess; it needn't be secret.
+inline uint64_t LinkNonce() {
+    static std::atomic<uint64_t> counter(0);
+    std::random_device rd;
+    std::string seed;
+    PutU64(seed, ((uint64_t)rd() << 32) | rd());
+    PutU64(seed, (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    PutU64(seed, ++counter);
+    return SipHash24((uint64_t)(uintptr_t)&counter, rd(), seed);
+}
+
+inline std::string LinkHello(uint64_t nonce) {
+    std::string out(LINK_MAGIC, LINK_MAGIC_BYTES);
+    PutU64(out, nonce);
+    return out;
+}
+
+// False if this isn't a chat server's peer port.
+inline bool ParseLinkHello(const char* p, uint64_t& nonce) {
+    if (memcmp(p, LINK_MAGIC, LINK_MAGIC_BYTES) != 0) return false;
+    nonce = GetU64(p + LINK_MAGIC_BYTES);
+    return true;
+}
+
+inline uint64_t LinkProof(const LinkKey& k, char role, uint64_t ownNonce, uint64_t otherNonce) {
+    std::string m(1, role);
+    PutU64(m, ownNonce);
+    PutU64(m, otherNonce);
+    return SipHash24(k.k0, k.k1, m);
+}
+
+#endif
@@ -10,6 +10,9 @@
 #define MSG_SIZE 256
 
 #include "resource.h"
+#include "../common/message_view_win32.h"
+
+#define WM_APP_MSG (WM_APP + 1)
 
 struct ShmData {
     unsigned long long seq;
@@ -17,9 +20,10 @@ struct ShmData {
 };
 
 // ===================== Globals =====================
-HWND hInput, hSendBtn, hListBox;
+HWND hMainWnd, hInput, hSendBtn, hListBox;
 HANDLE hMap, hMutex, hEvent;
 ShmData* shm = nullptr;
+MessageView msgView;
 
 bool running = true;
 unsigned long long lastSeq = 0;
@@ -106,8 +110,11 @@ void DrawButton(HDC hdc, RECT rc, const char* text) {
         DT_CENTER | DT_VCENTER | DT_SINGLELINE);
 }
 
+// Any thread may call AddMessage(); lines are queued in msgView and the
+// window flushes them to the listbox in one batch (WM_APP_MSG).
 void AddMessage(const char* msg) {
-    SendMessageA(hListBox, LB_ADDSTRING, 0, (LPARAM)msg);
+    if (msgView.Push(msg) && hMainWnd)
+        PostMessageA(hMainWnd, WM_APP_MSG, 0, 0);
 }
 
 // ===================== Receiver Thread =====================
@@ -153,6 +160,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
 
     case WM_CREATE:
+        hMainWnd = hwnd;
+
         hInput = CreateWindow("EDIT", "", WS_CHILD | WS_VISIBLE | WS_BORDER,
             50, 30, 300, 30, hwnd, NULL, NULL, NULL);
 
@@ -163,8 +172,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         hListBox = CreateWindow("LISTBOX", "",
             WS_CHILD | WS_VISIBLE | WS_BORDER,
             50, 80, 400, 350, hwnd, NULL, NULL, NULL);
+
+        // Pick up anything queued before the window existed
+        PostMessageA(hwnd, WM_APP_MSG, 0, 0);
         break;
 
+    case WM_APP_MSG:
+        FlushToListBox(msgView, hListBox);
+        return 0;
+
     case WM_DRAWITEM:
         DrawButton(((LPDRAWITEMSTRUCT)lParam)->hDC,
                    ((LPDRAWITEMSTRUCT)lParam)->rcItem,
@@ -9,6 +9,9 @@
 #define MAX_MESSAGES 32
 #define MSG_SIZE 256
 #include "resource.h"
+#include "../common/message_view_win32.h"
+
+#define WM_APP_MSG (WM_APP + 1)
 
 /*
 ==================== Developer Notes ====================
@@ -22,9 +25,10 @@ struct ShmData {
     char msgs[MAX_MESSAGES][MSG_SIZE];
 };
 
-HWND hInput, hSendBtn, hListBox;
+HWND hMainWnd, hInput, hSendBtn, hListBox;
 HANDLE hMap, hMutex, hEvent;
 ShmData* shm = nullptr;
+MessageView msgView;
 
 COLORREF btnColor   = RGB(70, 130, 180);
 COLORREF btnText    = RGB(255, 255, 255);
@@ -42,8 +46,11 @@ void DrawButton(HDC hdc, RECT rc, const char* text) {
 }
 
 // -------------------- Add message to listbox --------------------
+// Any thread may call AddMessage(); lines are queued in msgView and the
+// window flushes them to the listbox in one batch (WM_APP_MSG).
 void AddMessage(const char* msg) {
-    SendMessageA(hListBox, LB_ADDSTRING, 0, (LPARAM)msg);
+    if (msgView.Push(msg) && hMainWnd)
+        PostMessageA(hMainWnd, WM_APP_MSG, 0, 0);
 }
 
 // -------------------- Broadcast message from server --------------------
@@ -97,6 +104,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
 
     case WM_CREATE:
+        hMainWnd = hwnd;
+
         hInput = CreateWindow("EDIT", "", WS_CHILD | WS_VISIBLE | WS_BORDER,
             50, 30, 300, 30, hwnd, NULL, NULL, NULL);
 
@@ -107,8 +116,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         hListBox = CreateWindow("LISTBOX", "",
             WS_CHILD | WS_VISIBLE | WS_BORDER,
             50, 80, 400, 350, hwnd, NULL, NULL, NULL);
+
+        // Pick up anything queued before the window existed
+        PostMessageA(hwnd, WM_APP_MSG, 0, 0);
         break;
 
+    case WM_APP_MSG:
+        FlushToListBox(msgView, hListBox);
+        return 0;
+
     case WM_DRAWITEM:
         DrawButton(((LPDRAWITEMSTRUCT)lParam)->hDC,
                    ((LPDRAWITEMSTRUCT)lParam)->rcItem,